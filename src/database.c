@@ -1,11 +1,20 @@
 #include "include/database.h"
 #include "include/file_utils.h"
+#include "include/database_frames.h"
+#include "include/database_memory.h"
+#include "include/database_search.h"
+#include "include/database_packed.h"
+#include "include/database_thumbnails.h"
 #include <coelum/file_utils.h>
 #include <coelum/io.h>
 #include <string.h>
 #include <coelum/actor.h>
 #include <spr/spr.h>
 #include <coelum/textures.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DATABASE_BUSY_TIMEOUT 5000
 
 
 /**
@@ -36,10 +45,140 @@ char* get_random_string(unsigned int length)
     return string;
 }
 
+typedef struct DATABASE_READER_STRUCT
+{
+    database_T* database;
+    sqlite3* db;
+    struct DATABASE_READER_STRUCT* next;
+} database_reader_T;
+
+static sqlite3* database_open_file(const char* filename, int flags)
+{
+    sqlite3* db;
+
+    if (sqlite3_open_v2(filename, &db, flags | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_URI, NULL) != SQLITE_OK)
+    {
+        printf("Failed to open DB: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return (void*) 0;
+    }
+
+    sqlite3_busy_timeout(db, DATABASE_BUSY_TIMEOUT);
+
+    return db;
+}
+
+static sqlite3* database_open(database_T* database, int flags)
+{
+    return database_open_file(database->memory_uri != (void*) 0 ? database->memory_uri : database->filename, flags);
+}
+
+static void database_reader_free(void* value)
+{
+    database_reader_T* reader = (database_reader_T*) value;
+    database_T* database = reader->database;
+
+    pthread_mutex_lock(&database->readers_lock);
+
+    database_reader_T** link = &database->readers;
+
+    while (*link != (void*) 0 && *link != reader)
+        link = &(*link)->next;
+
+    if (*link != (void*) 0)
+        *link = reader->next;
+
+    pthread_mutex_unlock(&database->readers_lock);
+
+    sqlite3_close_v2(reader->db);
+    free(reader);
+}
+
 database_T* init_database()
+{
+    return init_database_with_flags(0);
+}
+
+database_T* init_database_with_flags(unsigned int flags)
+{
+    return init_database_from_file("application.db", flags);
+}
+
+static sqlite3* database_copy_into_memory(sqlite3* source, const char* memory_uri)
+{
+    sqlite3* memory_db;
+
+    if (sqlite3_open_v2(memory_uri, &memory_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Cannot open in-memory database: %s\n", sqlite3_errmsg(memory_db));
+        sqlite3_close(memory_db);
+
+        return (void*) 0;
+    }
+
+    sqlite3_backup* backup = sqlite3_backup_init(memory_db, "main", source, "main");
+
+    if (backup == (void*) 0)
+    {
+        fprintf(stderr, "Cannot copy database into memory: %s\n", sqlite3_errmsg(memory_db));
+        sqlite3_close(memory_db);
+
+        return (void*) 0;
+    }
+
+    sqlite3_backup_step(backup, -1);
+
+    if (sqlite3_backup_finish(backup) != SQLITE_OK)
+    {
+        fprintf(stderr, "Cannot copy database into memory: %s\n", sqlite3_errmsg(memory_db));
+        sqlite3_close(memory_db);
+
+        return (void*) 0;
+    }
+
+    return memory_db;
+}
+
+/**
+ * name under the directory filename is in, so the files a database keeps
+ * beside it do not depend on the working directory.
+ */
+static char* database_get_directory(const char* filename, const char* name)
+{
+    const char* slash = strrchr(filename, '/');
+    size_t directory_len = slash == (void*) 0 ? 0 : (size_t) (slash - filename) + 1;
+
+    char* directory = calloc(directory_len + strlen(name) + 1, sizeof(char));
+    strncpy(directory, filename, directory_len);
+    strcat(directory, name);
+
+    return directory;
+}
+
+database_T* init_database_from_file(const char* filename, unsigned int flags)
 {
     database_T* database = calloc(1, sizeof(struct DATABASE_STRUCT));
-    database->filename = "application.db";
+
+    char* filename_new = calloc(strlen(filename) + 1, sizeof(char));
+    strcpy(filename_new, filename);
+
+    database->filename = filename_new;
+    database->flags = flags;
+    database->scenes_directory = database_get_directory(filename, "scenes/");
+    database->frames_directory = database_get_directory(filename, "frames/");
+    database->atlases_directory = database_get_directory(filename, "atlases/");
+    database->intern_table = init_intern_table();
+    database->definition_cache = init_definition_cache(DATABASE_DEFINITION_CACHE_CAPACITY);
+    database->frame_pool = init_database_frame_pool();
+
+    pthread_key_create(&database->reader_key, database_reader_free);
+    pthread_mutex_init(&database->readers_lock, (void*) 0);
+    pthread_mutex_init(&database->sprite_writes_lock, (void*) 0);
+    pthread_cond_init(&database->sprite_writes_done, (void*) 0);
+    pthread_cond_init(&database->sprite_writes_queued, (void*) 0);
+
+    if (flags & DATABASE_SHARD_SCENES)
+        mkdir(database->scenes_directory, 0755);
 
     sqlite3 *db;
     char *err_msg = 0;
@@ -55,13 +194,55 @@ database_T* init_database()
         return database;
     }
 
-    char *sql = "CREATE TABLE IF NOT EXISTS actor_definitions(id TEXT, name TEXT, init_script_id TEXT, tick_script_id TEXT, draw_script_id TEXT, sprite_id TEXT);"
-                "CREATE TABLE IF NOT EXISTS actor_instances(id TEXT, actor_definition_id TEXT, x FLOAT, y FLOAT, z FLOAT, scene_id TEXT);"
-                "CREATE TABLE IF NOT EXISTS sprites(id TEXT, name TEXT, filepath TEXT);"
-                "CREATE TABLE IF NOT EXISTS scenes(id TEXT, name TEXT, bg_r INT, bg_g INT, bg_b INT, main INT);"
-                "CREATE TABLE IF NOT EXISTS scripts(id TEXT, name TEXT, filepath TEXT);";
+    const database_table_T* tables[] = {
+        &database_actor_definitions_table,
+        &database_actor_instances_table,
+        &database_sprites_table,
+        &database_scenes_table,
+        &database_scripts_table
+    };
+
+    for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]) && rc == SQLITE_OK; i++)
+    {
+        char* create_sql = database_table_create_sql(tables[i], (void*) 0);
+        rc = sqlite3_exec(db, create_sql, 0, 0, &err_msg);
+        free(create_sql);
+
+        if (rc == SQLITE_OK)
+            rc = database_table_migrate(db, tables[i], (void*) 0, &err_msg);
+    }
+
+    char *sql = "CREATE TABLE IF NOT EXISTS frames(hash TEXT PRIMARY KEY, filepath TEXT, width INT, height INT, refcount INT);"
+                "CREATE TABLE IF NOT EXISTS sprite_frames(sprite_id TEXT, frame INT, hash TEXT);"
+                "CREATE INDEX IF NOT EXISTS sprite_frames_sprite_id ON sprite_frames(sprite_id, frame);"
+                "CREATE INDEX IF NOT EXISTS actor_definitions_name ON actor_definitions(name);"
+                "CREATE INDEX IF NOT EXISTS actor_instances_scene_id ON actor_instances(scene_id);"
+                "DROP INDEX IF EXISTS sprites_name;"
+                "DROP INDEX IF EXISTS scenes_name;"
+                "DROP INDEX IF EXISTS scripts_name;"
+                "CREATE INDEX IF NOT EXISTS actor_definitions_page ON actor_definitions(COALESCE(name, ''));"
+                "CREATE INDEX IF NOT EXISTS sprites_page ON sprites(COALESCE(name, ''));"
+                "CREATE INDEX IF NOT EXISTS scenes_page ON scenes(COALESCE(name, ''));"
+                "CREATE INDEX IF NOT EXISTS scripts_page ON scripts(COALESCE(name, ''));"
+                "CREATE TABLE IF NOT EXISTS atlases(id TEXT, scene_id TEXT, filepath TEXT, width INT, height INT);"
+                "CREATE TABLE IF NOT EXISTS atlas_frames(atlas_id TEXT, scene_id TEXT, sprite_id TEXT, frame INT, x INT, y INT, width INT, height INT, u0 FLOAT, v0 FLOAT, u1 FLOAT, v1 FLOAT);"
+                "CREATE INDEX IF NOT EXISTS atlas_frames_sprite ON atlas_frames(scene_id, sprite_id, frame);"
+                "CREATE TABLE IF NOT EXISTS sprite_thumbnails(sprite_id TEXT PRIMARY KEY, width INT, height INT, pixels BLOB);"
+                "CREATE TRIGGER IF NOT EXISTS sprites_thumbnail_delete AFTER DELETE ON sprites BEGIN"
+                " DELETE FROM sprite_thumbnails WHERE sprite_id = old.id; END;";
     
-    rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+
+    if (rc == SQLITE_OK)
+    {
+        char* packed_sql = database_packed_create_sql("main");
+        rc = sqlite3_exec(db, packed_sql, 0, 0, &err_msg);
+        free(packed_sql);
+    }
+
+    if (rc == SQLITE_OK)
+        database->searchable = database_search_create_schema(db) == SQLITE_OK;
     
     if (rc != SQLITE_OK)
     {
@@ -73,32 +254,172 @@ database_T* init_database()
         
         return database;
     } 
+
+    if (flags & DATABASE_IN_MEMORY)
+    {
+        database->memory_uri = calloc(64, sizeof(char));
+        sprintf(database->memory_uri, "file:athena-%p?mode=memory&cache=shared", (void*) database);
+
+        database->db = database_copy_into_memory(db, database->memory_uri);
+
+        if (database->db == (void*) 0)
+        {
+            free(database->memory_uri);
+            database->memory_uri = (void*) 0;
+        }
+    }
+    else
+    {
+        sqlite3_exec(db, "PRAGMA journal_mode=WAL;", 0, 0, 0);
+    }
     
     sqlite3_close(db);
 
+    sqlite3* writer_db = database_open_file(database->filename, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+
+    // without its mirror a write would never reach the readers, there is
+    // no writer then and every write fails
+    if (writer_db != (void*) 0 && database->memory_uri != (void*) 0)
+    {
+        sqlite3* copy_db = database_open_file(database->memory_uri, SQLITE_OPEN_READWRITE);
+
+        if (copy_db != (void*) 0)
+            database->database_mirror = init_database_mirror(writer_db, copy_db);
+
+        if (database->database_mirror == (void*) 0)
+        {
+            printf("ERROR opening %s in memory: writes are disabled\n", database->filename);
+            sqlite3_close(writer_db);
+            writer_db = (void*) 0;
+        }
+    }
+
+    if (writer_db != (void*) 0)
+        database->database_writer = init_database_writer(writer_db);
+
     return database;
 }
 
+void database_free(database_T* database)
+{
+    pthread_mutex_lock(&database->sprite_writes_lock);
+
+    while (database->sprite_writes_pending > 0)
+        pthread_cond_wait(&database->sprite_writes_done, &database->sprite_writes_lock);
+
+    database->sprite_writes_stopping = 1;
+    pthread_cond_broadcast(&database->sprite_writes_queued);
+    pthread_mutex_unlock(&database->sprite_writes_lock);
+
+    for (unsigned int i = 0; i < database->sprite_write_threads_size; i++)
+        pthread_join(database->sprite_write_threads[i], (void*) 0);
+
+    database_frame_pool_free(database->frame_pool);
+
+    if (database->database_writer != (void*) 0)
+        database_writer_free(database->database_writer);
+
+    if (database->database_mirror != (void*) 0)
+        database_mirror_free(database->database_mirror);
+
+    pthread_mutex_lock(&database->readers_lock);
+
+    while (database->readers != (void*) 0)
+    {
+        database_reader_T* reader = database->readers;
+        database->readers = reader->next;
+
+        sqlite3_close_v2(reader->db);
+        free(reader);
+    }
+
+    pthread_mutex_unlock(&database->readers_lock);
+
+    pthread_key_delete(database->reader_key);
+    pthread_mutex_destroy(&database->readers_lock);
+    pthread_mutex_destroy(&database->sprite_writes_lock);
+    pthread_cond_destroy(&database->sprite_writes_done);
+    pthread_cond_destroy(&database->sprite_writes_queued);
+
+    if (database->db != (void*) 0)
+        sqlite3_close(database->db);
+
+    free(database->memory_uri);
+
+    free((char*) database->filename);
+    free(database->scenes_directory);
+    free(database->frames_directory);
+    free(database->atlases_directory);
+    definition_cache_free(database->definition_cache);
+    intern_table_free(database->intern_table);
+    free(database);
+}
+
+static size_t database_sprite_pixel_bytes(sprite_T* sprite)
+{
+    size_t bytes = 0;
+
+    for (int i = 0; i < sprite->textures->size; i++)
+    {
+        texture_T* texture = (texture_T*) sprite->textures->items[i];
+        bytes += (size_t) texture->width * texture->height * 4;
+    }
+
+    return bytes;
+}
+
+/**
+ * Swaps the pixels held by a database sprite, every sprite_T goes in and
+ * out through here so the pixel accounting stays balanced.
+ */
+static void database_sprite_set_sprite(database_sprite_T* database_sprite, sprite_T* sprite)
+{
+    if (database_sprite->sprite != (void*) 0)
+    {
+        database_memory_track_free(DATABASE_MEMORY_SPRITE_PIXELS, database_sprite_pixel_bytes(database_sprite->sprite));
+        sprite_free(database_sprite->sprite);
+    }
+
+    if (sprite != (void*) 0)
+        database_memory_track_alloc(DATABASE_MEMORY_SPRITE_PIXELS, database_sprite_pixel_bytes(sprite));
+
+    database_sprite->sprite = sprite;
+}
+
 database_sprite_T* init_database_sprite(char* id, char* name, char* filepath, sprite_T* sprite)
 {
     database_sprite_T* database_sprite = calloc(1, sizeof(struct DATABASE_SPRITE_STRUCT));
+    database_memory_track_alloc(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_SPRITE_STRUCT));
+
+    if (filepath != (void*) 0)
+        database_memory_track_alloc(DATABASE_MEMORY_STRINGS, strlen(filepath) + 1);
+
     database_sprite->id = id;
     database_sprite->name = name; 
     database_sprite->filepath = filepath;
-    database_sprite->sprite = sprite;
+    database_sprite_set_sprite(database_sprite, sprite);
+    atomic_init(&database_sprite->references, 1);
 
     return database_sprite;
 }
 
 void database_sprite_free(database_sprite_T* database_sprite)
 {
-    if (database_sprite->sprite != (void*) 0)
-        sprite_free(database_sprite->sprite);
+    if (atomic_fetch_sub(&database_sprite->references, 1) > 1)
+        return;
 
+    database_sprite_set_sprite(database_sprite, (void*) 0);
+
+    if (database_sprite->filepath != (void*) 0)
+        database_memory_track_free(DATABASE_MEMORY_STRINGS, strlen(database_sprite->filepath) + 1);
+
+    database_memory_track_free(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_SPRITE_STRUCT));
+
+    free(database_sprite->filepath);
     free(database_sprite);
 }
 
-void database_sprite_reload_from_disk(database_sprite_T* database_sprite)
+static void database_sprite_reload_from_disk(database_sprite_T* database_sprite)
 {
     printf(
         "Reloading sprite %s from file %s...\n",
@@ -106,10 +427,22 @@ void database_sprite_reload_from_disk(database_sprite_T* database_sprite)
         database_sprite->filepath
     );
 
-    if (database_sprite->sprite)
-        sprite_free(database_sprite->sprite);
+    database_sprite_set_sprite(database_sprite, load_sprite_from_disk(database_sprite->filepath));
+}
+
+/**
+ * Sprites stored before frames were content addressed are read from their
+ * own file, the others from their frames.
+ */
+void database_sprite_reload(database_T* database, database_sprite_T* database_sprite)
+{
+    if (database_sprite->filepath != (void*) 0)
+    {
+        database_sprite_reload_from_disk(database_sprite);
+        return;
+    }
 
-    database_sprite->sprite = load_sprite_from_disk(database_sprite->filepath);
+    database_sprite_set_sprite(database_sprite, database_load_sprite_frames(database, database_sprite->id));
 }
 
 database_actor_definition_T* init_database_actor_definition(
@@ -126,6 +459,7 @@ database_actor_definition_T* init_database_actor_definition(
         1,
         sizeof(struct DATABASE_ACTOR_DEFINITION_STRUCT)        
     );
+    database_memory_track_alloc(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_ACTOR_DEFINITION_STRUCT));
     database_actor_definition->id = id;
     database_actor_definition->name = name;
     database_actor_definition->sprite_id = sprite_id;
@@ -133,27 +467,164 @@ database_actor_definition_T* init_database_actor_definition(
     database_actor_definition->tick_script_id = tick_script_id;
     database_actor_definition->draw_script_id = draw_script_id;
     database_actor_definition->database_sprite = database_sprite;
+    pthread_mutex_init(&database_actor_definition->sprite_lock, (void*) 0);
+    atomic_init(&database_actor_definition->references, 1);
 
     return database_actor_definition;
 }
 
 void database_actor_definition_free(database_actor_definition_T* database_actor_definition)
 {
-    free(database_actor_definition->id);
-    free(database_actor_definition->sprite_id);
-    free(database_actor_definition->init_script_id);
-    free(database_actor_definition->tick_script_id);
-    free(database_actor_definition->draw_script_id);
-    database_sprite_free(database_actor_definition->database_sprite);
+    if (atomic_fetch_sub(&database_actor_definition->references, 1) > 1)
+        return;
+
+    if (database_actor_definition->database_sprite != (void*) 0)
+        database_sprite_free(database_actor_definition->database_sprite);
+
+    pthread_mutex_destroy(&database_actor_definition->sprite_lock);
+    database_memory_track_free(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_ACTOR_DEFINITION_STRUCT));
     free(database_actor_definition);
 }
 
+char* database_intern(database_T* database, const char* string)
+{
+    return intern_table_intern(database->intern_table, string);
+}
+
+sqlite3* database_open_reader(database_T* database)
+{
+    sqlite3* db = database_open(database, SQLITE_OPEN_READONLY);
+
+    // shared-cache readers would otherwise block on the writer's table locks
+    if (db != (void*) 0 && database->memory_uri != (void*) 0)
+        sqlite3_exec(db, "PRAGMA read_uncommitted=1;", 0, 0, 0);
+
+    return db;
+}
+
+static sqlite3* database_open_connection(database_T* database)
+{
+    database_reader_T* reader = pthread_getspecific(database->reader_key);
+
+    if (reader != (void*) 0)
+        return reader->db;
+
+    sqlite3* db = database_open_reader(database);
+
+    if (db == (void*) 0)
+        return (void*) 0;
+
+    reader = calloc(1, sizeof(struct DATABASE_READER_STRUCT));
+    reader->database = database;
+    reader->db = db;
+
+    pthread_mutex_lock(&database->readers_lock);
+    reader->next = database->readers;
+    database->readers = reader;
+    pthread_mutex_unlock(&database->readers_lock);
+
+    pthread_setspecific(database->reader_key, reader);
+
+    return db;
+}
+
+typedef struct DATABASE_SQL_WRITE_STRUCT
+{
+    database_T* database;
+    const char* scene_id;
+    const char* sql;
+} database_sql_write_T;
+
+static int database_run_sql_write(sqlite3* db, void* user_data)
+{
+    database_sql_write_T* write = (database_sql_write_T*) user_data;
+
+    if (write->scene_id != (void*) 0 && !database_attach_scene(write->database, db, write->scene_id, 1))
+        return SQLITE_ERROR;
+
+    char* err_msg = 0;
+    int rc = sqlite3_exec(db, write->sql, 0, 0, &err_msg);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR executing query: %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+
+    if (write->scene_id != (void*) 0)
+        database_detach_scene(write->database, db, write->scene_id);
+
+    return rc;
+}
+
+/**
+ * Runs the statements of user_data in one transaction on the writer.
+ */
+static int database_run_transaction(sqlite3* db, void* user_data)
+{
+    char* err_msg = 0;
+    int rc = sqlite3_exec(db, "BEGIN", 0, 0, &err_msg);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, (const char*) user_data, 0, 0, &err_msg);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "COMMIT", 0, 0, &err_msg);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR executing query: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+    }
+
+    return rc;
+}
+
+int database_submit_write(database_T* database, database_write_callback callback, void* user_data)
+{
+    if (database->database_writer == (void*) 0)
+    {
+        printf("Failed to open DB\n");
+        return SQLITE_CANTOPEN;
+    }
+
+    return database_writer_submit(database->database_writer, callback, user_data);
+}
+
+/**
+ * Prints sql before it runs when built with DATABASE_DEBUG.
+ */
+static void database_debug_query(const char* sql)
+{
+#ifdef DATABASE_DEBUG
+    printf("Performing query...\n");
+    printf("%s\n", sql);
+#endif
+}
+
+int database_exec_write(database_T* database, const char* scene_id, const char* sql)
+{
+    database_debug_query(sql);
+
+    database_sql_write_T write;
+    write.database = database;
+    write.scene_id = database->flags & DATABASE_SHARD_SCENES ? scene_id : (void*) 0;
+    write.sql = sql;
+
+    return database_submit_write(database, database_run_sql_write, &write);
+}
+
 sqlite3_stmt* database_exec_sql(database_T* database, char* sql, unsigned int do_error_checking)
 {
-    sqlite3* db = database->db;
+    if (do_error_checking)
+    {
+        database_exec_write(database, (void*) 0, sql);
+        return (void*) 0;
+    }
+
 	sqlite3_stmt* stmt;
-	
-	sqlite3_open(database->filename, &db);
+	sqlite3* db = database_open_connection(database);
 
 	if (db == NULL)
 	{
@@ -161,315 +632,744 @@ sqlite3_stmt* database_exec_sql(database_T* database, char* sql, unsigned int do
 		return (void*) 0;
 	}
 
-	printf("Performing query...\n");
-    printf("%s\n", sql);
-	sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+	database_debug_query(sql);
 
-    if (do_error_checking)
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
     {
-        int rc = sqlite3_step(stmt);
-
-        if (rc != SQLITE_DONE)
-        {
-            printf("ERROR executing query: %s\n", sqlite3_errmsg(db));
-            return (void*) 0;
-        }
+        printf("ERROR preparing query: %s\n", sqlite3_errmsg(db));
+        return (void*) 0;
     }
 
 	return stmt;
 }
 
-char* database_insert_sprite(database_T* database, const char* name, sprite_T* sprite)
+void database_finalize(database_T* database, sqlite3_stmt* stmt)
 {
-    char* id = get_random_string(16);
-    char* sql_template = "INSERT INTO sprites VALUES(\'%s\', \'%s\', \'%s\')";
-    char* sql = calloc(300, sizeof(char));
-
-    char* filepath = calloc(strlen("sprites/") + strlen(name) + strlen(".bin"), sizeof(char));
-    sprintf(filepath, "sprites/%s.spr", name);
+    sqlite3_finalize(stmt);
+}
 
-    sprintf(sql, sql_template, id, name, filepath);
-    printf("%s\n", sql);
+char* database_column_intern(database_T* database, sqlite3_stmt* stmt, int column)
+{
+    const unsigned char* text = sqlite3_column_text(stmt, column);
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
-    free(sql);
+    if (text == (void*) 0)
+        return (void*) 0;
 
-    spr_frame_T** frames = (void*) 0;
-    size_t frames_size = 0;
+    return intern_table_intern_n(database->intern_table, (const char*) text, sqlite3_column_bytes(stmt, column));
+}
 
-    for (int i = 0; i < sprite->textures->size; i++)
+char* database_get_scene_schema(database_T* database, const char* scene_id)
+{
+    if (!(database->flags & DATABASE_SHARD_SCENES))
     {
-        texture_T* texture = (texture_T*) sprite->textures->items[i];
-        spr_frame_T* frame = spr_init_frame_from_data(texture->data, texture->width, texture->height);
-        frames_size += 1;
-        frames = realloc(frames, frames_size * sizeof(struct SPR_FRAME_STRUCT*));
-        frames[frames_size-1] = frame;
-    }
-
-    spr_T* spr = init_spr(
-        sprite->width,
-        sprite->height,
-        255,
-        255,
-        255,
-        sprite->frame_delay,
-        sprite->animate,
-        frames,
-        frames_size
-    );
+        char* schema = calloc(strlen("main") + 1, sizeof(char));
+        strcpy(schema, "main");
 
-    spr_write_to_file(spr, filepath);
+        return schema;
+    }
 
-    spr_free(spr);
+    char* schema = calloc(strlen("scene_") + strlen(scene_id) + 1, sizeof(char));
+    sprintf(schema, "scene_%s", scene_id);
 
-    return id;
+    return schema;
 }
 
-void database_update_sprite_name_by_id(database_T* database, const char* id, const char* name)
+char* database_get_scene_filepath(database_T* database, const char* scene_id)
 {
-    char* sql_template = "UPDATE sprites SET name=\'%s\' WHERE id=\'%s\'";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + strlen(name) + 1, sizeof(char));
-    sprintf(sql, sql_template, name, id);
+    char* filepath = calloc(strlen(database->scenes_directory) + strlen(scene_id) + strlen(".db") + 1, sizeof(char));
+    sprintf(filepath, "%s%s.db", database->scenes_directory, scene_id);
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    return filepath;
+}
+
+/**
+ * Creates or migrates the tables of a shard opened or attached as schema.
+ */
+static int database_create_scene_tables(sqlite3* db, const char* schema, char** err_msg)
+{
+    // like the main database, so streaming queries holding a read open
+    // on the shard do not block its writes
+    char* journal_sql = calloc(strlen("PRAGMA .journal_mode=WAL") + strlen(schema) + 1, sizeof(char));
+    sprintf(journal_sql, "PRAGMA %s.journal_mode=WAL", schema);
+    sqlite3_exec(db, journal_sql, 0, 0, 0);
+    free(journal_sql);
 
-    int rc = sqlite3_step(stmt);
+    char* create_sql = database_table_create_sql(&database_actor_instances_table, schema);
+    int rc = sqlite3_exec(db, create_sql, 0, 0, err_msg);
+    free(create_sql);
 
-    if (rc != SQLITE_DONE)
+    if (rc == SQLITE_OK)
+        rc = database_table_migrate(db, &database_actor_instances_table, schema, err_msg);
+
+    if (rc == SQLITE_OK)
     {
-        printf("ERROR executing query: %s\n", sqlite3_errmsg(database->db));
+        create_sql = calloc(strlen("CREATE INDEX IF NOT EXISTS .actor_instances_scene_id ON actor_instances(scene_id)") + strlen(schema) + 1, sizeof(char));
+        sprintf(create_sql, "CREATE INDEX IF NOT EXISTS %s.actor_instances_scene_id ON actor_instances(scene_id)", schema);
+        rc = sqlite3_exec(db, create_sql, 0, 0, err_msg);
+        free(create_sql);
     }
 
-	sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
+    if (rc == SQLITE_OK)
+    {
+        create_sql = database_packed_create_sql(schema);
+        rc = sqlite3_exec(db, create_sql, 0, 0, err_msg);
+        free(create_sql);
+    }
+
+    return rc;
 }
 
-database_sprite_T* database_get_sprite_by_id(database_T* database, const char* id)
+sqlite3* database_open_scene(database_T* database, const char* scene_id)
 {
-    char* sql_template = "SELECT * FROM sprites WHERE id=\'%s\' LIMIT 1";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
-    sprintf(sql, sql_template, id);
+    char* filepath = database_get_scene_filepath(database, scene_id);
+    sqlite3* db = database_open_file(filepath, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    free(filepath);
+
+    if (db == (void*) 0)
+        return (void*) 0;
+
+    char* err_msg = 0;
+
+    if (database_create_scene_tables(db, "main", &err_msg) != SQLITE_OK)
+    {
+        printf("ERROR opening scene %s: %s\n", scene_id, err_msg);
+        sqlite3_free(err_msg);
+        sqlite3_close(db);
+
+        return (void*) 0;
+    }
+
+    return db;
+}
+
+unsigned int database_attach_scene(database_T* database, sqlite3* db, const char* scene_id, unsigned int writable)
+{
+    char* schema = database_get_scene_schema(database, scene_id);
+
+    if (sqlite3_db_filename(db, schema) != (void*) 0)
+    {
+        free(schema);
+        return 1;
+    }
+
+    char* filepath = database_get_scene_filepath(database, scene_id);
+
+    // readers cannot create a shard, a scene without one simply has no instances yet
+    if (!writable && access(filepath, F_OK) != 0)
+    {
+        free(filepath);
+        free(schema);
+        return 0;
+    }
+
+    char* sql_template = "ATTACH DATABASE \'%s\' AS %s;";
+    char* sql = calloc(strlen(sql_template) + strlen(filepath) + strlen(schema) + 1, sizeof(char));
+    sprintf(sql, sql_template, filepath, schema);
+
+    char* err_msg = 0;
+    int rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+
+    if (rc == SQLITE_OK && writable)
+        rc = database_create_scene_tables(db, schema, &err_msg);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR attaching scene %s: %s\n", scene_id, err_msg);
+        sqlite3_free(err_msg);
+    }
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
     free(sql);
+    free(filepath);
+    free(schema);
 
-    const unsigned char* name = 0;
-    const unsigned char* filepath = 0;
-    sprite_T* sprite = (void*) 0;
+    return rc == SQLITE_OK;
+}
 
-    if (sqlite3_step(stmt) != SQLITE_DONE)
+void database_detach_scene(database_T* database, sqlite3* db, const char* scene_id)
+{
+    char* schema = database_get_scene_schema(database, scene_id);
+    char* sql = calloc(strlen("DETACH DATABASE ") + strlen(schema) + 1, sizeof(char));
+    sprintf(sql, "DETACH DATABASE %s", schema);
+
+    if (sqlite3_db_filename(db, schema) != (void*) 0)
+        sqlite3_exec(db, sql, 0, 0, 0);
+
+    free(sql);
+    free(schema);
+}
+
+sqlite3_stmt* database_exec_scene_sql(database_T* database, const char* scene_id, char* sql, unsigned int do_error_checking)
+{
+    if (do_error_checking)
     {
-        name = sqlite3_column_text(stmt, 1);
-        filepath = sqlite3_column_text(stmt, 2);
+        database_exec_write(database, scene_id, sql);
+        return (void*) 0;
+    }
 
-        if (filepath)
-            sprite = load_sprite_from_disk(filepath);
-	}
-    else
+    if (!(database->flags & DATABASE_SHARD_SCENES))
+        return database_exec_sql(database, sql, 0);
+
+    sqlite3_stmt* stmt;
+    sqlite3* db = database_open_connection(database);
+
+    if (db == NULL)
     {
+        printf("Failed to open DB\n");
         return (void*) 0;
     }
 
-    char* id_new = calloc(strlen(id) + 1, sizeof(char));
-    strcpy(id_new, id);
+    if (!database_attach_scene(database, db, scene_id, 0))
+        return (void*) 0;
+
+    database_debug_query(sql);
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        printf("ERROR preparing query: %s\n", sqlite3_errmsg(db));
+        database_detach_scene(database, db, scene_id);
+        return (void*) 0;
+    }
 
-    char* name_new = calloc(strlen(name) + 1, sizeof(char));
-    strcpy(name_new, name);
+    return stmt;
+}
 
-    char* filepath_new = calloc(strlen(filepath) + 1, sizeof(char));
-    strcpy(filepath_new, filepath);
+void database_finalize_scene(database_T* database, const char* scene_id, sqlite3_stmt* stmt)
+{
+    if (stmt == (void*) 0)
+        return;
 
+    sqlite3* db = sqlite3_db_handle(stmt);
     sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
 
-    return init_database_sprite(id_new, name_new, filepath_new, sprite);
+    if (database->flags & DATABASE_SHARD_SCENES)
+        database_detach_scene(database, db, scene_id);
 }
 
-void database_delete_sprite_by_id(database_T* database, const char* id)
+typedef struct DATABASE_ROW_WRITE_STRUCT
+{
+    database_T* database;
+    const char* scene_id;
+    const database_table_T* table;
+    const char* sql;
+    const void* row;
+} database_row_write_T;
+
+static int database_run_row_write(sqlite3* db, void* user_data)
 {
-    database_sprite_T* database_sprite = database_get_sprite_by_id(database, id);
+    database_row_write_T* write = (database_row_write_T*) user_data;
+    sqlite3_stmt* stmt;
 
-    if (database_sprite->sprite != (void*) 0)
-        delete_file(database_sprite->filepath);
+    if (write->scene_id != (void*) 0 && !database_attach_scene(write->database, db, write->scene_id, 1))
+        return SQLITE_ERROR;
 
-    char* sql_template = "DELETE FROM sprites WHERE id=\'%s\'";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
+    int rc = sqlite3_prepare_v2(db, write->sql, -1, &stmt, NULL);
 
-    sprintf(sql, sql_template, id);
+    if (rc == SQLITE_OK)
+    {
+        database_table_bind(stmt, write->table, write->row);
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+    }
+
+    if (rc != SQLITE_OK)
+        printf("ERROR executing query: %s\n", sqlite3_errmsg(db));
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
     sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
-    free(sql);
 
-    database_sprite_free(database_sprite);
+    if (write->scene_id != (void*) 0)
+        database_detach_scene(write->database, db, write->scene_id);
+
+    return rc;
 }
 
-char* database_insert_actor_definition(
+/**
+ * Runs a generated insert or update with the columns of row bound.
+ */
+static int database_write_row(
     database_T* database,
-    const char* name,
-    const char* sprite_id,
-    const char* init_script_id,
-    const char* tick_script_id,
-    const char* draw_script_id
+    const char* scene_id,
+    const database_table_T* table,
+    const char* sql,
+    const void* row
 )
 {
-    char* id = get_random_string(16);
-    char* sql_template = "INSERT INTO actor_definitions VALUES(\'%s\', \'%s\', \'%s\', \'%s\', \'%s\', \'%s\')";
-    char* sql = calloc(600, sizeof(char));
+    database_debug_query(sql);
 
-    sprintf(sql, sql_template, id, name, init_script_id, tick_script_id, draw_script_id, sprite_id);
+    database_row_write_T write;
+    write.database = database;
+    write.scene_id = database->flags & DATABASE_SHARD_SCENES ? scene_id : (void*) 0;
+    write.table = table;
+    write.sql = sql;
+    write.row = row;
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
+    return database_submit_write(database, database_run_row_write, &write);
+}
+
+static int database_insert_row(database_T* database, const database_table_T* table, const void* row)
+{
+    char* sql = database_table_insert_sql(table, (void*) 0);
+    int rc = database_write_row(database, (void*) 0, table, sql, row);
     free(sql);
 
-    return id;
+    return rc;
 }
 
-database_actor_definition_T* database_get_actor_definition_by_id(database_T* database, const char* id)
+static int database_update_row(database_T* database, const database_table_T* table, const void* row)
 {
-    char* sql_template = "SELECT * FROM actor_definitions WHERE id=\'%s\' LIMIT 1";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
-    sprintf(sql, sql_template, id);
+    char* sql = database_table_update_sql(table, (void*) 0);
+    int rc = database_write_row(database, (void*) 0, table, sql, row);
+    free(sql);
+
+    return rc;
+}
+
+/**
+ * Reads the first row whose column equals value into row, returns 0 when
+ * there is none.
+ */
+static unsigned int database_select_row(
+    database_T* database,
+    const database_table_T* table,
+    const char* column,
+    const char* value,
+    void* row
+)
+{
+    char* clause = calloc(strlen("WHERE =? LIMIT 1") + strlen(column) + 1, sizeof(char));
+    sprintf(clause, "WHERE %s=? LIMIT 1", column);
+
+    char* sql = database_table_select_sql(table, (void*) 0, (void*) 0, clause);
+    free(clause);
 
     sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
     free(sql);
 
-    const unsigned char* name = 0;
-    const unsigned char* sprite_id = 0;
-    const unsigned char* init_script_id = 0;
-    const unsigned char* tick_script_id = 0;
-    const unsigned char* draw_script_id = 0;
+    if (stmt == (void*) 0)
+        return 0;
 
-    if (sqlite3_step(stmt) != SQLITE_DONE)
+    sqlite3_bind_text(stmt, 1, value, -1, SQLITE_STATIC);
+
+    unsigned int found = sqlite3_step(stmt) == SQLITE_ROW;
+
+    if (found)
+        database_table_read(stmt, table, database->intern_table, 0, row);
+
+    database_finalize(database, stmt);
+
+    return found;
+}
+
+typedef struct DATABASE_SPRITE_WRITE_STRUCT
+{
+    database_T* database;
+    database_sprite_T database_sprite;
+    uint64_t* hashes;
+    database_thumbnail_T* database_thumbnail;
+    database_sprite_inserted_callback callback;
+    void* user_data;
+    struct DATABASE_SPRITE_WRITE_STRUCT* next;
+} database_sprite_write_T;
+
+static database_sprite_write_T* init_database_sprite_write(database_T* database, const char* name, sprite_T* sprite)
+{
+    database_sprite_write_T* write = calloc(1, sizeof(struct DATABASE_SPRITE_WRITE_STRUCT));
+    write->database = database;
+    write->hashes = calloc(sprite->textures->size, sizeof(uint64_t));
+
+    database_sprite_T* database_sprite = &write->database_sprite;
+    database_sprite->id = get_random_string(16);
+    database_sprite->name = calloc(strlen(name) + 1, sizeof(char));
+    strcpy(database_sprite->name, name);
+    database_sprite->width = sprite->width;
+    database_sprite->height = sprite->height;
+    database_sprite->frame_delay = sprite->frame_delay;
+    database_sprite->animate = sprite->animate;
+    database_sprite->sprite = sprite;
+
+    return write;
+}
+
+static void database_sprite_write_free(database_sprite_write_T* write)
+{
+    free(write->database_sprite.id);
+    free(write->database_sprite.name);
+    free(write->hashes);
+
+    if (write->database_thumbnail != (void*) 0)
+        database_thumbnail_free(write->database_thumbnail);
+
+    free(write);
+}
+
+static int database_run_sprite_write(sqlite3* db, void* user_data)
+{
+    database_sprite_write_T* write = (database_sprite_write_T*) user_data;
+    database_sprite_T* database_sprite = &write->database_sprite;
+    sqlite3_stmt* stmt;
+
+    sqlite3_exec(db, "BEGIN", 0, 0, 0);
+
+    char* sql = database_table_insert_sql(&database_sprites_table, (void*) 0);
+    sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    free(sql);
+
+    database_table_bind(stmt, &database_sprites_table, database_sprite);
+    int rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+    sqlite3_finalize(stmt);
+
+    if (rc == SQLITE_OK)
+        rc = database_store_sprite_frames(db, write->database->frames_directory, database_sprite->id, database_sprite->sprite->textures, write->hashes);
+
+    if (rc == SQLITE_OK && write->database_thumbnail != (void*) 0)
+        rc = database_store_sprite_thumbnail(db, database_sprite->id, write->database_thumbnail);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "COMMIT", 0, 0, 0);
+
+    if (rc != SQLITE_OK)
     {
-        name = sqlite3_column_text(stmt, 1);
-        init_script_id = sqlite3_column_text(stmt, 2);
-        tick_script_id = sqlite3_column_text(stmt, 3);
-        draw_script_id = sqlite3_column_text(stmt, 4);
-        sprite_id = sqlite3_column_text(stmt, 5);
-	}	
+        printf("ERROR inserting sprite: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
 
-    char* id_new = calloc(strlen(id) + 1, sizeof(char));
-    strcpy(id_new, id);
-    
-    char* name_new = calloc(strlen(name) + 1, sizeof(char));
-    strcpy(name_new, name);
+        database_discard_sprite_frames(db, write->database->frames_directory, database_sprite->sprite->textures, write->hashes);
+    }
+
+    return rc;
+}
 
-    char* sprite_id_new = calloc(strlen(sprite_id) + 1, sizeof(char));
-    strcpy(sprite_id_new, sprite_id);
+/**
+ * Frames are hashed and encoded in parallel on the calling thread, the
+ * writer only has to look the hashes up and insert the rows.
+ */
+static int database_sprite_write_run(database_sprite_write_T* write)
+{
+    dynamic_list_T* textures = write->database_sprite.sprite->textures;
 
-    char* init_script_id_new = (void*)0;
+    database_encode_sprite_frames(write->database, textures, write->hashes);
 
-    if (strlen(init_script_id))
+    if (textures->size > 0)
+        write->database_thumbnail = init_database_thumbnail_from_texture((texture_T*) textures->items[0]);
+
+    return database_submit_write(write->database, database_run_sprite_write, write);
+}
+
+char* database_insert_sprite(database_T* database, const char* name, sprite_T* sprite)
+{
+    database_sprite_write_T* write = init_database_sprite_write(database, name, sprite);
+    database_sprite_write_run(write);
+
+    char* id = write->database_sprite.id;
+    write->database_sprite.id = (void*) 0;
+    database_sprite_write_free(write);
+
+    return id;
+}
+
+static void database_sprite_write_finish(database_sprite_write_T* write, int rc)
+{
+    database_T* database = write->database;
+
+    if (write->callback != (void*) 0)
+        write->callback(write->database_sprite.id, rc, write->user_data);
+
+    database_sprite_write_free(write);
+
+    pthread_mutex_lock(&database->sprite_writes_lock);
+    database->sprite_writes_pending -= 1;
+    pthread_cond_broadcast(&database->sprite_writes_done);
+    pthread_mutex_unlock(&database->sprite_writes_lock);
+}
+
+/**
+ * Worker draining the queued asynchronous sprite inserts until the
+ * database is freed.
+ */
+static void* database_sprite_write_thread(void* arg)
+{
+    database_T* database = (database_T*) arg;
+
+    while (1)
     {
-        init_script_id_new = calloc(strlen(init_script_id) + 1, sizeof(char));
-        strcpy(init_script_id_new, init_script_id);
+        pthread_mutex_lock(&database->sprite_writes_lock);
+
+        while (database->sprite_writes_head == (void*) 0 && !database->sprite_writes_stopping)
+            pthread_cond_wait(&database->sprite_writes_queued, &database->sprite_writes_lock);
+
+        database_sprite_write_T* write = database->sprite_writes_head;
+
+        if (write != (void*) 0)
+        {
+            database->sprite_writes_head = write->next;
+
+            if (database->sprite_writes_head == (void*) 0)
+                database->sprite_writes_tail = (void*) 0;
+        }
+
+        pthread_mutex_unlock(&database->sprite_writes_lock);
+
+        if (write == (void*) 0)
+            break;
+
+        database_sprite_write_finish(write, database_sprite_write_run(write));
     }
-    
-    char* tick_script_id_new = (void*)0;
 
-    if (strlen(tick_script_id))
+    // callbacks may have read, close that connection while the database is still alive
+    database_reader_T* reader = pthread_getspecific(database->reader_key);
+
+    if (reader != (void*) 0)
+    {
+        pthread_setspecific(database->reader_key, (void*) 0);
+        database_reader_free(reader);
+    }
+
+    return (void*) 0;
+}
+
+char* database_insert_sprite_async(database_T* database, const char* name, sprite_T* sprite, database_sprite_inserted_callback callback, void* user_data)
+{
+    database_sprite_write_T* write = init_database_sprite_write(database, name, sprite);
+    write->callback = callback;
+    write->user_data = user_data;
+
+    char* id = calloc(strlen(write->database_sprite.id) + 1, sizeof(char));
+    strcpy(id, write->database_sprite.id);
+
+    pthread_mutex_lock(&database->sprite_writes_lock);
+
+    database->sprite_writes_pending += 1;
+
+    // workers are started as the queue needs them, up to the limit
+    if (database->sprite_write_threads_size < DATABASE_SPRITE_WRITE_THREADS &&
+        database->sprite_write_threads_size < database->sprite_writes_pending &&
+        pthread_create(
+            &database->sprite_write_threads[database->sprite_write_threads_size],
+            (void*) 0,
+            database_sprite_write_thread,
+            database
+        ) == 0)
+        database->sprite_write_threads_size += 1;
+
+    unsigned int queued = database->sprite_write_threads_size > 0;
+
+    if (queued)
+    {
+        if (database->sprite_writes_tail != (void*) 0)
+            database->sprite_writes_tail->next = write;
+        else
+            database->sprite_writes_head = write;
+
+        database->sprite_writes_tail = write;
+        pthread_cond_signal(&database->sprite_writes_queued);
+    }
+
+    pthread_mutex_unlock(&database->sprite_writes_lock);
+
+    if (!queued)
     {
-        tick_script_id_new = calloc(strlen(tick_script_id) + 1, sizeof(char));
-        strcpy(tick_script_id_new, tick_script_id);
+        printf("ERROR starting sprite write, writing synchronously\n");
+        database_sprite_write_finish(write, database_sprite_write_run(write));
     }
 
-    char* draw_script_id_new = (void*)0;
+    return id;
+}
+
+void database_update_sprite_name_by_id(database_T* database, const char* id, const char* name)
+{
+    database_sprite_T* database_sprite = init_database_sprite((void*) 0, (void*) 0, (void*) 0, (void*) 0);
+
+    if (database_select_row(database, &database_sprites_table, "id", id, database_sprite))
+    {
+        database_sprite->name = (char*) name;
+        database_update_row(database, &database_sprites_table, database_sprite);
+    }
 
-    if (strlen(draw_script_id))
+    database_sprite_free(database_sprite);
+
+    definition_cache_remove_by_sprite_id(database->definition_cache, intern_table_find(database->intern_table, id));
+}
+
+database_sprite_T* database_get_sprite_by_id(database_T* database, const char* id)
+{
+    database_sprite_T* database_sprite = init_database_sprite((void*) 0, (void*) 0, (void*) 0, (void*) 0);
+
+    if (!database_select_row(database, &database_sprites_table, "id", id, database_sprite))
     {
-        draw_script_id_new = calloc(strlen(draw_script_id) + 1, sizeof(char));
-        strcpy(draw_script_id_new, draw_script_id);
+        database_sprite_free(database_sprite);
+        return (void*) 0;
     }
 
-    sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
-
-    return init_database_actor_definition(
-        id_new,
-        name_new,
-        sprite_id_new,
-        init_script_id_new,
-        tick_script_id_new,
-        draw_script_id_new,
-        database_get_sprite_by_id(database, sprite_id_new)
+    if (database_sprite->filepath != (void*) 0)
+        database_sprite_set_sprite(database_sprite, load_sprite_from_disk(database_sprite->filepath));
+    else
+        database_sprite_set_sprite(database_sprite, database_load_sprite_frames(database, database_sprite->id));
+
+    return database_sprite;
+}
+
+static int database_run_sprite_delete(sqlite3* db, void* user_data)
+{
+    const char* id = (const char*) user_data;
+    sqlite3_stmt* stmt;
+
+    dynamic_list_T* released_filepaths = init_dynamic_list(sizeof(char*));
+
+    sqlite3_exec(db, "BEGIN", 0, 0, 0);
+
+    int rc = database_release_sprite_frames(db, id, released_filepaths);
+
+    // sprites stored before frames were content addressed own a whole file
+    if (rc == SQLITE_OK && sqlite3_prepare_v2(db, "SELECT filepath FROM sprites WHERE id=?", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, id, -1, SQLITE_STATIC);
+
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0) != (void*) 0)
+        {
+            const char* filepath = (const char*) sqlite3_column_text(stmt, 0);
+            char* released_filepath = calloc(strlen(filepath) + 1, sizeof(char));
+            strcpy(released_filepath, filepath);
+            dynamic_list_append(released_filepaths, released_filepath);
+        }
+
+        sqlite3_finalize(stmt);
+    }
+
+    sqlite3_prepare_v2(db, "DELETE FROM sprites WHERE id=?", -1, &stmt, NULL);
+    sqlite3_bind_text(stmt, 1, id, -1, SQLITE_STATIC);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+
+    sqlite3_finalize(stmt);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "COMMIT", 0, 0, 0);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR deleting sprite: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+    }
+
+    database_delete_frame_files(released_filepaths, rc == SQLITE_OK);
+
+    return rc;
+}
+
+void database_delete_sprite_by_id(database_T* database, const char* id)
+{
+    database_submit_write(database, database_run_sprite_delete, (void*) id);
+
+    definition_cache_remove_by_sprite_id(database->definition_cache, intern_table_find(database->intern_table, id));
+}
+
+char* database_insert_actor_definition(
+    database_T* database,
+    const char* name,
+    const char* sprite_id,
+    const char* init_script_id,
+    const char* tick_script_id,
+    const char* draw_script_id
+)
+{
+    char* id = get_random_string(16);
+
+    database_actor_definition_T database_actor_definition = { 0 };
+    database_actor_definition.id = id;
+    database_actor_definition.name = (char*) name;
+    database_actor_definition.sprite_id = (char*) sprite_id;
+    database_actor_definition.init_script_id = (char*) init_script_id;
+    database_actor_definition.tick_script_id = (char*) tick_script_id;
+    database_actor_definition.draw_script_id = (char*) draw_script_id;
+
+    database_insert_row(database, &database_actor_definitions_table, &database_actor_definition);
+
+    return id;
+}
+
+static database_actor_definition_T* database_get_actor_definition_where(
+    database_T* database,
+    const char* column,
+    const char* value
+)
+{
+    database_actor_definition_T* database_actor_definition = init_database_actor_definition(
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0
+    );
+
+    unsigned long generation = definition_cache_generation(database->definition_cache);
+
+    if (!database_select_row(database, &database_actor_definitions_table, column, value, database_actor_definition))
+    {
+        database_actor_definition_free(database_actor_definition);
+        return (void*) 0;
+    }
+
+    definition_cache_put(database->definition_cache, database_actor_definition, generation);
+
+    return database_actor_definition;
+}
+
+database_actor_definition_T* database_get_actor_definition_by_id(database_T* database, const char* id)
+{
+    database_actor_definition_T* database_actor_definition = definition_cache_get_by_id(
+        database->definition_cache,
+        intern_table_find(database->intern_table, id)
     );
+
+    if (database_actor_definition != (void*) 0)
+        return database_actor_definition;
+
+    return database_get_actor_definition_where(database, "id", id);
 }
 
 database_actor_definition_T* database_get_actor_definition_by_name(database_T* database, const char* name)
 {
-    char* sql_template = "SELECT * FROM actor_definitions WHERE name=\'%s\' LIMIT 1";
-    char* sql = calloc(strlen(sql_template) + strlen(name) + 1, sizeof(char));
-    sprintf(sql, sql_template, name);
+    database_actor_definition_T* database_actor_definition = definition_cache_get_by_name(
+        database->definition_cache,
+        intern_table_find(database->intern_table, name)
+    );
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
-    free(sql);
+    if (database_actor_definition != (void*) 0)
+        return database_actor_definition;
 
-    const unsigned char* id = 0;
-    const unsigned char* sprite_id = 0;
-    const unsigned char* init_script_id = 0;
-    const unsigned char* tick_script_id = 0;
-    const unsigned char* draw_script_id = 0;
+    return database_get_actor_definition_where(database, "name", name);
+}
 
-    if (sqlite3_step(stmt) != SQLITE_DONE)
-    {
-        id = sqlite3_column_text(stmt, 0);
-        init_script_id = sqlite3_column_text(stmt, 2);
-        tick_script_id = sqlite3_column_text(stmt, 3);
-        draw_script_id = sqlite3_column_text(stmt, 4);
-        sprite_id = sqlite3_column_text(stmt, 5);
-	}	
+database_sprite_T* database_actor_definition_get_sprite(
+    database_T* database,
+    database_actor_definition_T* database_actor_definition
+)
+{
+    pthread_mutex_lock(&database_actor_definition->sprite_lock);
 
-    char* id_new = calloc(strlen(id) + 1, sizeof(char));
-    strcpy(id_new, id);
-    
-    char* name_new = calloc(strlen(name) + 1, sizeof(char));
-    strcpy(name_new, name);
+    if (database_actor_definition->database_sprite == (void*) 0 && database_actor_definition->sprite_id != (void*) 0)
+        database_actor_definition->database_sprite = database_get_sprite_by_id(database, database_actor_definition->sprite_id);
 
-    char* sprite_id_new = calloc(strlen(sprite_id) + 1, sizeof(char));
-    strcpy(sprite_id_new, sprite_id);
+    database_sprite_T* database_sprite = database_actor_definition->database_sprite;
 
-    char* init_script_id_new = (void*)0;
+    if (database_sprite != (void*) 0)
+        database_sprite->references += 1;
 
-    if (strlen(init_script_id))
-    {
-        init_script_id_new = calloc(strlen(init_script_id) + 1, sizeof(char));
-        strcpy(init_script_id_new, init_script_id);
-    }
-    
-    char* tick_script_id_new = (void*)0;
+    pthread_mutex_unlock(&database_actor_definition->sprite_lock);
 
-    if (strlen(tick_script_id))
-    {
-        tick_script_id_new = calloc(strlen(tick_script_id) + 1, sizeof(char));
-        strcpy(tick_script_id_new, tick_script_id);
-    }
+    return database_sprite;
+}
 
-    char* draw_script_id_new = (void*)0;
+void database_actor_definition_release_sprite(database_actor_definition_T* database_actor_definition)
+{
+    pthread_mutex_lock(&database_actor_definition->sprite_lock);
 
-    if (strlen(draw_script_id))
-    {
-        draw_script_id_new = calloc(strlen(draw_script_id) + 1, sizeof(char));
-        strcpy(draw_script_id_new, draw_script_id);
-    }
+    if (database_actor_definition->database_sprite != (void*) 0)
+        database_sprite_free(database_actor_definition->database_sprite);
 
-    sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
-
-    return init_database_actor_definition(
-        id_new,
-        name_new,
-        sprite_id_new,
-        init_script_id_new,
-        tick_script_id_new,
-        draw_script_id_new,
-        database_get_sprite_by_id(database, sprite_id_new)
-    );
+    database_actor_definition->database_sprite = (void*) 0;
+
+    pthread_mutex_unlock(&database_actor_definition->sprite_lock);
 }
 
 void database_update_actor_definition_by_id(
@@ -482,61 +1382,17 @@ void database_update_actor_definition_by_id(
     const char* draw_script_id
 )
 {
-    char* sql_template = 
-        "UPDATE actor_definitions SET name=\'%s\',"
-        " sprite_id=\'%s\',"
-        " init_script_id=\'%s\',"
-        " tick_script_id=\'%s\',"
-        " draw_script_id=\'%s\'"
-        " WHERE id=\'%s\';";
-
-    size_t init_script_id_len = 0;
-    size_t tick_script_id_len = 0;
-    size_t draw_script_id_len = 0;
-
-    if (init_script_id != (void*) 0)
-        init_script_id_len = strlen(init_script_id);
-
-    if (tick_script_id != (void*) 0)
-        tick_script_id_len = strlen(tick_script_id);
-
-    if (draw_script_id != (void*) 0)
-        draw_script_id_len = strlen(draw_script_id);
-
-    char* sql = calloc(
-        strlen(sql_template) +
-        strlen(id) +
-        strlen(name) +
-        init_script_id_len +
-        tick_script_id_len +
-        draw_script_id_len +
-        128,
-        sizeof(char)
-    );
-
-    sprintf(
-        sql,
-        sql_template,
-        name,
-        sprite_id,
-        init_script_id == (void*) 0 ? "" : init_script_id,
-        tick_script_id == (void*) 0 ? "" : tick_script_id,
-        draw_script_id == (void*) 0 ? "" : draw_script_id,
-        id
-    );
-
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
-
-    int rc = sqlite3_step(stmt);
+    database_actor_definition_T database_actor_definition = { 0 };
+    database_actor_definition.id = (char*) id;
+    database_actor_definition.name = (char*) name;
+    database_actor_definition.sprite_id = (char*) sprite_id;
+    database_actor_definition.init_script_id = (char*) init_script_id;
+    database_actor_definition.tick_script_id = (char*) tick_script_id;
+    database_actor_definition.draw_script_id = (char*) draw_script_id;
 
-    if (rc != SQLITE_DONE)
-    {
-        printf("ERROR executing query: %s\n", sqlite3_errmsg(database->db));
-    }
+    database_update_row(database, &database_actor_definitions_table, &database_actor_definition);
 
-	sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
-    free(sql);
+    definition_cache_remove_by_id(database->definition_cache, intern_table_find(database->intern_table, id));
 }
 
 void database_delete_actor_definition_by_id(database_T* database, const char* id)
@@ -549,16 +1405,21 @@ void database_delete_actor_definition_by_id(database_T* database, const char* id
     sprintf(sql, sql_template, id);
 
     sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
+    database_finalize(database, stmt);
     free(sql);
+
+    definition_cache_remove_by_id(database->definition_cache, intern_table_find(database->intern_table, id));
 }
 
 database_scene_T* init_database_scene(char* id, char* name, unsigned int main)
 {
     database_scene_T* database_scene = calloc(1, sizeof(struct DATABASE_SCENE_STRUCT));
+    database_memory_track_alloc(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_SCENE_STRUCT));
     database_scene->id = id;
     database_scene->name = name;
+    database_scene->bg_r = 255;
+    database_scene->bg_g = 255;
+    database_scene->bg_b = 255;
     database_scene->main = main;
 
     return database_scene;
@@ -566,43 +1427,21 @@ database_scene_T* init_database_scene(char* id, char* name, unsigned int main)
 
 void database_scene_free(database_scene_T* database_scene)
 {
-    free(database_scene->id);
-    free(database_scene->name);
+    database_memory_track_free(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_SCENE_STRUCT));
     free(database_scene);
 }
 
 database_scene_T* database_get_scene_by_id(database_T* database, const char* id)
 {
-    char* sql_template = "SELECT * FROM scenes WHERE id=\'%s\' LIMIT 1";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
-    sprintf(sql, sql_template, id);
-
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
-    free(sql);
+    database_scene_T* database_scene = init_database_scene((void*) 0, (void*) 0, 0);
 
-    const unsigned char* name = 0;
-    unsigned int main = 0;
-
-    if (sqlite3_step(stmt) != SQLITE_DONE)
+    if (!database_select_row(database, &database_scenes_table, "id", id, database_scene))
     {
-        name = sqlite3_column_text(stmt, 1);
-        main = sqlite3_column_int(stmt, 5);
-	}	
-
-    char* id_new = calloc(strlen(id) + 1, sizeof(char));
-    strcpy(id_new, id);
-    
-    char* name_new = calloc(strlen(name) + 1, sizeof(char));
-    strcpy(name_new, name);
-
-    sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
+        database_scene_free(database_scene);
+        return (void*) 0;
+    }
 
-    return init_database_scene(
-        id_new,
-        name_new,
-        main
-    );
+    return database_scene;
 }
 
 unsigned int database_count_scenes(database_T* database)
@@ -618,8 +1457,7 @@ unsigned int database_count_scenes(database_T* database)
         count = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
+    database_finalize(database, stmt);
 
     return count;
 }
@@ -627,85 +1465,249 @@ unsigned int database_count_scenes(database_T* database)
 char* database_insert_scene(database_T* database, const char* name, unsigned int main)
 {
     char* id = get_random_string(16);
-    char* sql_template = "INSERT INTO scenes VALUES(\'%s\', \'%s\', 255, 255, 255, %d)";
-    char* sql = calloc(400, sizeof(char));
 
-    sprintf(sql, sql_template, id, name, main);
+    database_scene_T* database_scene = init_database_scene(id, (char*) name, main);
+    database_insert_row(database, &database_scenes_table, database_scene);
+    database_scene_free(database_scene);
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
+    return id;
+}
+
+typedef struct DATABASE_SCENE_COPY_STRUCT
+{
+    database_T* database;
+    const char* scene_id;
+    const char* copy_id;
+    const char* name;
+} database_scene_copy_T;
+
+/**
+ * Replacement expressions for database_table_copy_sql, NULL for every
+ * column not named in names.
+ */
+static const char** database_scene_copy_replacements(const database_table_T* table, const char** names, const char** expressions, int size)
+{
+    const char** replacements = calloc(table->columns_size, sizeof(char*));
+
+    for (size_t i = 0; i < table->columns_size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            if (strcmp(table->columns[i].name, names[j]) == 0)
+                replacements[i] = expressions[j];
+        }
+    }
+
+    return replacements;
+}
+
+static int database_run_scene_copy(sqlite3* db, void* user_data)
+{
+    database_scene_copy_T* copy = (database_scene_copy_T*) user_data;
+    database_T* database = copy->database;
+    unsigned int sharded = database->flags & DATABASE_SHARD_SCENES;
+    sqlite3_stmt* stmt;
+
+    // a scene that never got a shard has no instances to copy
+    unsigned int has_instances = !sharded || database_attach_scene(database, db, copy->scene_id, 0);
+
+    if (sharded && !database_attach_scene(database, db, copy->copy_id, 1))
+    {
+        database_detach_scene(database, db, copy->scene_id);
+        return SQLITE_ERROR;
+    }
+
+    sqlite3_exec(db, "BEGIN", 0, 0, 0);
+
+    const char* scene_names[] = { "id", "name", "main" };
+    const char* scene_expressions[] = { "?1", "coalesce(?2, name)", "0" };
+    const char** replacements = database_scene_copy_replacements(&database_scenes_table, scene_names, scene_expressions, 3);
+    char* sql = database_table_copy_sql(&database_scenes_table, (void*) 0, (void*) 0, replacements, "WHERE id=?3");
+    free(replacements);
+
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
     free(sql);
 
-    return id;
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, copy->copy_id, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, copy->name, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, copy->scene_id, -1, SQLITE_STATIC);
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+
+        if (rc == SQLITE_OK && sqlite3_changes(db) == 0)
+            rc = SQLITE_NOTFOUND;
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (rc == SQLITE_OK && has_instances)
+    {
+        char* schema = database_get_scene_schema(database, copy->copy_id);
+        char* from_schema = database_get_scene_schema(database, copy->scene_id);
+        const char* instance_names[] = { "id", "scene_id" };
+        const char* instance_expressions[] = { "lower(hex(randomblob(8)))", "?1" };
+
+        replacements = database_scene_copy_replacements(&database_actor_instances_table, instance_names, instance_expressions, 2);
+        sql = database_table_copy_sql(&database_actor_instances_table, schema, from_schema, replacements, "WHERE scene_id=?2");
+        free(replacements);
+        free(from_schema);
+        free(schema);
+
+        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+        free(sql);
+
+        if (rc == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, copy->copy_id, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, copy->scene_id, -1, SQLITE_STATIC);
+            rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        }
+
+        sqlite3_finalize(stmt);
+    }
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "COMMIT", 0, 0, 0);
+
+    if (rc != SQLITE_OK)
+    {
+        if (rc == SQLITE_NOTFOUND)
+            printf("ERROR duplicating scene %s: no such scene\n", copy->scene_id);
+        else
+            printf("ERROR duplicating scene: %s\n", sqlite3_errmsg(db));
+
+        sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+    }
+
+    if (sharded)
+    {
+        database_detach_scene(database, db, copy->scene_id);
+        database_detach_scene(database, db, copy->copy_id);
+    }
+
+    return rc;
+}
+
+char* database_duplicate_scene(database_T* database, const char* scene_id, const char* name)
+{
+    char* id = get_random_string(16);
+
+    database_scene_copy_T copy;
+    copy.database = database;
+    copy.scene_id = scene_id;
+    copy.copy_id = id;
+    copy.name = name;
+
+    if (database_submit_write(database, database_run_scene_copy, &copy) == SQLITE_OK)
+        return id;
+
+    // the failed copy may have left an empty scene file behind
+    if (database->flags & DATABASE_SHARD_SCENES)
+    {
+        char* filepath = database_get_scene_filepath(database, id);
+
+        if (access(filepath, F_OK) == 0)
+            delete_file(filepath);
+
+        free(filepath);
+    }
+
+    free(id);
+
+    return (void*) 0;
 }
 
 void database_delete_scene_by_id(database_T* database, const char* id)
 {
     database_delete_actor_instances_by_scene_id(database, id);
 
-    char* sql_template = "DELETE FROM scenes WHERE id=\'%s\'";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
+    if (database->flags & DATABASE_SHARD_SCENES)
+    {
+        char* filepath = database_get_scene_filepath(database, id);
+
+        if (access(filepath, F_OK) == 0)
+            delete_file(filepath);
 
+        free(filepath);
+    }
+
+    dynamic_list_T* atlas_filepaths = init_dynamic_list(sizeof(char*));
+
+    char* sql_template = "SELECT filepath FROM atlases WHERE scene_id=\'%s\'";
+    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
     sprintf(sql, sql_template, id);
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
+    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
     free(sql);
-}
 
-void database_update_scene_by_id(database_T* database, const char* id, const char* name, unsigned int main)
-{
-    char* sql_template = "UPDATE scenes SET name=\'%s\', main=%d WHERE id=\'%s\'";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + strlen(name) + 128, sizeof(char));
-    sprintf(sql, sql_template, name, main, id);
+    while (stmt != (void*) 0 && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* filepath = (const char*) sqlite3_column_text(stmt, 0);
+        char* atlas_filepath = calloc(strlen(filepath) + 1, sizeof(char));
+        strcpy(atlas_filepath, filepath);
+        dynamic_list_append(atlas_filepaths, atlas_filepath);
+    }
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    database_finalize(database, stmt);
+
+    sql_template = "DELETE FROM packed_scenes WHERE scene_id=\'%s\';"
+                   "DELETE FROM atlas_frames WHERE scene_id=\'%s\';"
+                   "DELETE FROM atlases WHERE scene_id=\'%s\';"
+                   "DELETE FROM scenes WHERE id=\'%s\';";
+    sql = calloc(strlen(sql_template) + strlen(id) * 4 + 1, sizeof(char));
+    sprintf(sql, sql_template, id, id, id, id);
 
-    int rc = sqlite3_step(stmt);
+    int rc = database_submit_write(database, database_run_transaction, sql);
+    free(sql);
 
-    if (rc != SQLITE_DONE)
+    // the atlas images are only removed once nothing refers to them anymore
+    for (int i = 0; i < atlas_filepaths->size; i++)
     {
-        printf("ERROR executing query: %s\n", sqlite3_errmsg(database->db));
+        char* filepath = (char*) atlas_filepaths->items[i];
+
+        if (rc == SQLITE_OK && access(filepath, F_OK) == 0)
+            delete_file(filepath);
+
+        free(filepath);
     }
 
-	sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
-    free(sql);
+    free(atlas_filepaths->items);
+    free(atlas_filepaths);
+}
+
+void database_update_scene_by_id(database_T* database, const char* id, const char* name, unsigned int main)
+{
+    database_scene_T* database_scene = database_get_scene_by_id(database, id);
+
+    if (database_scene == (void*) 0)
+        return;
+
+    database_scene->name = (char*) name;
+    database_scene->main = main;
+
+    database_update_row(database, &database_scenes_table, database_scene);
+    database_scene_free(database_scene);
 }
 
 dynamic_list_T* database_get_all_scenes(database_T* database)
 {
     dynamic_list_T* database_scenes = init_dynamic_list(sizeof(struct DATABASE_SCENE_STRUCT*));
 
-    char* sql = "SELECT * FROM scenes ORDER BY main DESC";
+    char* sql = database_table_select_sql(&database_scenes_table, (void*) 0, (void*) 0, "ORDER BY main DESC");
 
     sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    free(sql);
 
-    while (sqlite3_step(stmt) != SQLITE_DONE)
+    while (stmt != (void*) 0 && sqlite3_step(stmt) == SQLITE_ROW)
     {
-        const char* id = sqlite3_column_text(stmt, 0);
-        const unsigned char* name = sqlite3_column_text(stmt, 1);;
-        unsigned int main = sqlite3_column_int(stmt, 5);
-
-        char* id_new = calloc(strlen(id) + 1, sizeof(char));
-        strcpy(id_new, id);
-        
-        char* name_new = calloc(strlen(name) + 1, sizeof(char));
-        strcpy(name_new, name);
-
-        database_scene_T* database_scene = init_database_scene(
-            id_new,
-            name_new,
-            main            
-        );
+        database_scene_T* database_scene = init_database_scene((void*) 0, (void*) 0, 0);
+        database_table_read(stmt, &database_scenes_table, database->intern_table, 0, database_scene);
 
         dynamic_list_append(database_scenes, database_scene);
 	}
 
-    sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
+    database_finalize(database, stmt);
 
     return database_scenes;
 }
@@ -713,17 +1715,8 @@ dynamic_list_T* database_get_all_scenes(database_T* database)
 void database_unset_main_flag_on_all_scenes(database_T* database)
 {
     char* sql = "UPDATE scenes SET main=0";
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
-
-    int rc = sqlite3_step(stmt);
-
-    if (rc != SQLITE_DONE)
-    {
-        printf("ERROR executing query: %s\n", sqlite3_errmsg(database->db));
-    }
-
-	sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
+    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
+    database_finalize(database, stmt);
 }
 
 database_actor_instance_T* init_database_actor_instance(
@@ -737,6 +1730,7 @@ database_actor_instance_T* init_database_actor_instance(
 )
 {
     database_actor_instance_T* database_actor_instance = calloc(1, sizeof(struct DATABASE_ACTOR_INSTANCE_STRUCT));
+    database_memory_track_alloc(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_ACTOR_INSTANCE_STRUCT));
     database_actor_instance->id = id;
     database_actor_instance->actor_definition_id = actor_definition_id;
     database_actor_instance->scene_id = scene_id;
@@ -750,10 +1744,10 @@ database_actor_instance_T* init_database_actor_instance(
 
 void database_actor_instance_free(database_actor_instance_T* database_actor_instance)
 {
-    free(database_actor_instance->id);
-    free(database_actor_instance->actor_definition_id);
-    free(database_actor_instance->scene_id);
-    database_actor_definition_free(database_actor_instance->database_actor_definition);
+    if (database_actor_instance->database_actor_definition != (void*) 0)
+        database_actor_definition_free(database_actor_instance->database_actor_definition);
+
+    database_memory_track_free(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_ACTOR_INSTANCE_STRUCT));
     free(database_actor_instance);
 }
 
@@ -767,122 +1761,166 @@ char* database_insert_actor_instance(
 )
 {
     char* id = get_random_string(16);
-    char* sql_template = "INSERT INTO actor_instances VALUES(\'%s\', \'%s\', %12.6f, %12.6f, %12.6f, \'%s\')";
-    char* sql = calloc(400, sizeof(char));
+    char* schema = database_get_scene_schema(database, scene_id);
+    char* sql = database_table_insert_sql(&database_actor_instances_table, schema);
+
+    database_actor_instance_T database_actor_instance = { 0 };
+    database_actor_instance.id = id;
+    database_actor_instance.actor_definition_id = (char*) actor_definition_id;
+    database_actor_instance.scene_id = (char*) scene_id;
+    database_actor_instance.x = x;
+    database_actor_instance.y = y;
+    database_actor_instance.z = z;
+
+    database_write_row(database, scene_id, &database_actor_instances_table, sql, &database_actor_instance);
+    free(schema);
+    free(sql);
 
-    sprintf(sql, sql_template, id, actor_definition_id, x, y, z, scene_id);
+    return id;
+}
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
+sqlite3_stmt* database_prepare_actor_instances_by_scene_id(database_T* database, const char* scene_id)
+{
+    char* schema = database_get_scene_schema(database, scene_id);
+    char* sql = database_table_select_sql(&database_actor_instances_table, schema, (void*) 0, "WHERE scene_id=?");
+    free(schema);
+
+    sqlite3_stmt* stmt = database_exec_scene_sql(database, scene_id, sql, 0);
     free(sql);
 
-    return id;
+    if (stmt != (void*) 0)
+        sqlite3_bind_text(stmt, 1, scene_id, -1, SQLITE_TRANSIENT);
+
+    return stmt;
+}
+
+database_actor_instance_T* database_actor_instance_from_row(database_T* database, sqlite3_stmt* stmt, int first_column)
+{
+    database_actor_instance_T* database_actor_instance = init_database_actor_instance(
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        0,
+        0,
+        0,
+        (void*) 0
+    );
+
+    database_table_read(stmt, &database_actor_instances_table, database->intern_table, first_column, database_actor_instance);
+
+    database_actor_instance->database_actor_definition = database_get_actor_definition_by_id(
+        database,
+        database_actor_instance->actor_definition_id
+    );
+
+    return database_actor_instance;
 }
 
 dynamic_list_T* database_get_all_actor_instances_by_scene_id(database_T* database, const char* scene_id)
 {
-    dynamic_list_T* database_actor_instances = init_dynamic_list(sizeof(struct DATABASE_ACTOR_INSTANCE_STRUCT*));
-    
-    char* sql_template = "SELECT * FROM actor_instances WHERE scene_id=\'%s\'";
-    char* sql = calloc(strlen(sql_template) + strlen(scene_id) + 1, sizeof(char));
-    sprintf(sql, sql_template, scene_id);
+    database_packed_scene_T* database_packed_scene = (void*) 0;
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    if (database->flags & DATABASE_PACK_INSTANCES)
+        database_packed_scene = database_load_packed_scene(database, scene_id);
 
-    while (sqlite3_step(stmt) != SQLITE_DONE)
+    if (database_packed_scene != (void*) 0)
     {
-        const unsigned char* id = sqlite3_column_text(stmt, 0);
-        const unsigned char* actor_definition_id = sqlite3_column_text(stmt, 1);
-        const float x = sqlite3_column_double(stmt, 2);
-        const float y = sqlite3_column_double(stmt, 3);
-        const float z = sqlite3_column_double(stmt, 4);
+        dynamic_list_T* database_actor_instances = database_packed_scene_get_actor_instances(database, database_packed_scene);
+        database_packed_scene_free(database_packed_scene);
 
-        char* id_new = calloc(strlen(id) + 1, sizeof(char));
-        strcpy(id_new, id);
-        
-        char* actor_definition_id_new = calloc(strlen(actor_definition_id) + 1, sizeof(char));
-        strcpy(actor_definition_id_new, actor_definition_id);
-
-        char* scene_id_new = calloc(strlen(scene_id) + 1, sizeof(char));
-        strcpy(scene_id_new, scene_id);
-
-        database_actor_instance_T* database_actor_instance = init_database_actor_instance(
-            id_new,
-            actor_definition_id_new,
-            scene_id_new,
-            x,
-            y,
-            z,
-            database_get_actor_definition_by_id(database, actor_definition_id)
-        );
-
-        dynamic_list_append(database_actor_instances, database_actor_instance);
+        return database_actor_instances;
+    }
+
+    dynamic_list_T* database_actor_instances = init_dynamic_list(sizeof(struct DATABASE_ACTOR_INSTANCE_STRUCT*));
+
+    sqlite3_stmt* stmt = database_prepare_actor_instances_by_scene_id(database, scene_id);
+
+    if (stmt == (void*) 0)
+        return database_actor_instances;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        dynamic_list_append(database_actor_instances, database_actor_instance_from_row(database, stmt, 0));
 	}
 
-    sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
+    database_finalize_scene(database, scene_id, stmt);
+
+    // the next load of the scene is a single read, without this one waiting on the writer
+    if (database->flags & DATABASE_PACK_INSTANCES)
+        database_queue_scene_pack(database, scene_id);
 
     return database_actor_instances;
 }
 
-void database_delete_actor_instance_by_id(database_T* database, const char* id)
+static void database_delete_actor_instances_where(database_T* database, const char* scene_id, const char* column, const char* value)
 {
-    const char* sql_template = "DELETE FROM actor_instances WHERE id='%s'";
-    char* sql = calloc(1, (strlen(sql_template) + strlen(id) + 1) * sizeof(char));
+    char* schema = database_get_scene_schema(database, scene_id);
+    char* sql_template = "DELETE FROM %s.actor_instances WHERE %s=\'%s\'";
+    char* sql = calloc(strlen(sql_template) + strlen(schema) + strlen(column) + strlen(value) + 1, sizeof(char));
 
-    sprintf(sql, sql_template, id);
+    sprintf(sql, sql_template, schema, column, value);
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
+    sqlite3_stmt* stmt = database_exec_scene_sql(database, scene_id, sql, 1);
+    database_finalize_scene(database, scene_id, stmt);
+    free(schema);
     free(sql);
 }
 
-void database_delete_actor_instances_by_actor_definition_id(database_T* database, const char* id)
+static void database_delete_actor_instances_in_all_scenes(database_T* database, const char* column, const char* value)
 {
-    char* sql_template = "DELETE FROM actor_instances WHERE actor_definition_id=\'%s\'";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
+    if (!(database->flags & DATABASE_SHARD_SCENES))
+    {
+        database_delete_actor_instances_where(database, (void*) 0, column, value);
+        return;
+    }
 
-    sprintf(sql, sql_template, id);
+    dynamic_list_T* database_scenes = database_get_all_scenes(database);
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
-    free(sql);
+    for (int i = 0; i < database_scenes->size; i++)
+    {
+        database_scene_T* database_scene = (database_scene_T*) database_scenes->items[i];
+        database_delete_actor_instances_where(database, database_scene->id, column, value);
+        database_scene_free(database_scene);
+    }
+
+    free(database_scenes->items);
+    free(database_scenes);
 }
 
-void database_delete_actor_instances_by_scene_id(database_T* database, const char* id)
+void database_delete_actor_instance_by_id(database_T* database, const char* id)
 {
-    char* sql_template = "DELETE FROM actor_instances WHERE scene_id=\'%s\'";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
+    database_delete_actor_instances_in_all_scenes(database, "id", id);
+}
 
-    sprintf(sql, sql_template, id);
+void database_delete_actor_instances_by_actor_definition_id(database_T* database, const char* id)
+{
+    database_delete_actor_instances_in_all_scenes(database, "actor_definition_id", id);
+}
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
-    free(sql);
+void database_delete_actor_instances_by_scene_id(database_T* database, const char* id)
+{
+    database_delete_actor_instances_where(database, id, "scene_id", id);
 }
 
 unsigned int database_count_actors_in_scene(database_T* database, const char* scene_id)
 {
-    const char* sql_template = "SELECT count(*) FROM actor_instances WHERE scene_id=\'%s\'";
-    char* sql = calloc(1, (strlen(sql_template) + strlen(scene_id) + 1) * sizeof(char));
+    char* schema = database_get_scene_schema(database, scene_id);
+    const char* sql_template = "SELECT count(*) FROM %s.actor_instances WHERE scene_id=\'%s\'";
+    char* sql = calloc(1, (strlen(sql_template) + strlen(schema) + strlen(scene_id) + 1) * sizeof(char));
 
-    sprintf(sql, sql_template, scene_id);
+    sprintf(sql, sql_template, schema, scene_id);
+    free(schema);
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    sqlite3_stmt* stmt = database_exec_scene_sql(database, scene_id, sql, 0);
 
     unsigned int count = 0;
 
-    if (sqlite3_step(stmt) != SQLITE_DONE)
+    if (stmt != (void*) 0 && sqlite3_step(stmt) == SQLITE_ROW)
     {
         count = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
+    database_finalize_scene(database, scene_id, stmt);
 
     free(sql);
 
@@ -892,21 +1930,42 @@ unsigned int database_count_actors_in_scene(database_T* database, const char* sc
 database_script_T* init_database_script(char* id, char* name, char* filepath, char* contents)
 {
     database_script_T* database_script = calloc(1, sizeof(struct DATABASE_SCRIPT_STRUCT));
+    database_memory_track_alloc(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_SCRIPT_STRUCT));
+
+    if (filepath != (void*) 0)
+        database_memory_track_alloc(DATABASE_MEMORY_STRINGS, strlen(filepath) + 1);
+
     database_script->id = id;
     database_script->name = name;
     database_script->filepath = filepath;
-    database_script->contents = contents;
+    database_script_set_contents(database_script, contents);
 
     return database_script;
 }
 
+void database_script_set_contents(database_script_T* database_script, char* contents)
+{
+    if (database_script->contents != (void*) 0)
+        database_memory_track_free(DATABASE_MEMORY_SCRIPTS, strlen(database_script->contents) + 1);
+
+    if (contents != (void*) 0)
+        database_memory_track_alloc(DATABASE_MEMORY_SCRIPTS, strlen(contents) + 1);
+
+    database_script->contents = contents;
+}
+
 void database_script_free(database_script_T* database_script)
 {
-    free(database_script->id);
-    free(database_script->name);
+    if (database_script->filepath != (void*) 0)
+        database_memory_track_free(DATABASE_MEMORY_STRINGS, strlen(database_script->filepath) + 1);
+
     free(database_script->filepath);
-    // TODO: free database_script->contents
-    
+
+    char* contents = database_script->contents;
+    database_script_set_contents(database_script, (void*) 0);
+    free(contents);
+
+    database_memory_track_free(DATABASE_MEMORY_ENTITIES, sizeof(struct DATABASE_SCRIPT_STRUCT));
     free(database_script);
 }
 
@@ -917,54 +1976,28 @@ char* database_insert_script(
 )
 {
     char* id = get_random_string(16);
-    char* sql_template = "INSERT INTO scripts VALUES(\'%s\', \'%s\', \'%s\')";
-    char* sql = calloc(400, sizeof(char));
 
-    sprintf(sql, sql_template, id, name, filepath);
+    database_script_T database_script = { 0 };
+    database_script.id = id;
+    database_script.name = (char*) name;
+    database_script.filepath = (char*) filepath;
 
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 1);
-    sqlite3_finalize(stmt);
-    sqlite3_close(database->db);
-    free(sql);
+    database_insert_row(database, &database_scripts_table, &database_script);
 
     return id;
 }
 
 database_script_T* database_get_script_by_id(database_T* database, const char* id)
 {
-    char* sql_template = "SELECT * FROM scripts WHERE id=\'%s\' LIMIT 1";
-    char* sql = calloc(strlen(sql_template) + strlen(id) + 1, sizeof(char));
-    sprintf(sql, sql_template, id);
-
-    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
-    free(sql);
+    database_script_T* database_script = init_database_script((void*) 0, (void*) 0, (void*) 0, (void*) 0);
 
-    const unsigned char* name = 0;
-    const unsigned char* filepath = 0;
-    char* contents;
-
-    if (sqlite3_step(stmt) != SQLITE_DONE)
-    {
-        name = sqlite3_column_text(stmt, 1);
-        filepath = sqlite3_column_text(stmt, 2);
-        contents = read_file(filepath);
-	}
-    else
+    if (!database_select_row(database, &database_scripts_table, "id", id, database_script))
     {
+        database_script_free(database_script);
         return (void*) 0;
     }
 
-    char* id_new = calloc(strlen(id) + 1, sizeof(char));
-    strcpy(id_new, id);
-
-    char* name_new = calloc(strlen(name) + 1, sizeof(char));
-    strcpy(name_new, name);
+    database_script_set_contents(database_script, read_file(database_script->filepath));
 
-    char* filepath_new = calloc(strlen(filepath) + 1, sizeof(char));
-    strcpy(filepath_new, filepath);
-
-    sqlite3_finalize(stmt);
-	sqlite3_close(database->db);
-
-    return init_database_script(id_new, name_new, filepath_new, contents);
+    return database_script;
 }
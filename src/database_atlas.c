@@ -0,0 +1,529 @@
+#include "include/database_atlas.h"
+#include "include/file_utils.h"
+#include <coelum/textures.h>
+#include <spr/spr.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// gap between packed frames so filtering never samples a neighbour
+#define DATABASE_ATLAS_PADDING 1
+
+
+typedef struct ATLAS_FRAME_SOURCE_STRUCT
+{
+    char* sprite_id;
+    unsigned int frame;
+    texture_T* texture;
+    unsigned int atlas;
+    int x;
+    int y;
+} atlas_frame_source_T;
+
+typedef struct ATLAS_SKYLINE_NODE_STRUCT
+{
+    int x;
+    int y;
+    int width;
+} atlas_skyline_node_T;
+
+typedef struct ATLAS_PAGE_STRUCT
+{
+    char* id;
+    atlas_skyline_node_T* nodes;
+    size_t nodes_size;
+    unsigned char* pixels;
+} atlas_page_T;
+
+void database_atlas_frame_free(database_atlas_frame_T* database_atlas_frame)
+{
+    free(database_atlas_frame->filepath);
+    free(database_atlas_frame);
+}
+
+static atlas_page_T* init_atlas_page(unsigned int atlas_size)
+{
+    atlas_page_T* atlas_page = calloc(1, sizeof(struct ATLAS_PAGE_STRUCT));
+    atlas_page->id = get_random_string(16);
+    atlas_page->nodes = calloc(1, sizeof(struct ATLAS_SKYLINE_NODE_STRUCT));
+    atlas_page->nodes[0].width = atlas_size;
+    atlas_page->nodes_size = 1;
+    atlas_page->pixels = calloc((size_t) atlas_size * atlas_size * 4, sizeof(unsigned char));
+
+    return atlas_page;
+}
+
+static void atlas_page_free(atlas_page_T* atlas_page)
+{
+    free(atlas_page->id);
+    free(atlas_page->nodes);
+    free(atlas_page->pixels);
+    free(atlas_page);
+}
+
+/**
+ * Skyline bottom-left: returns the y a width-wide rectangle would rest at
+ * when its left edge is on node index, or -1 if it does not fit there.
+ */
+static int atlas_page_fit(atlas_page_T* atlas_page, size_t index, int width, int height, unsigned int atlas_size)
+{
+    int x = atlas_page->nodes[index].x;
+
+    if (x + width > (int) atlas_size)
+        return -1;
+
+    int y = 0;
+    int remaining = width;
+
+    for (size_t i = index; remaining > 0; i++)
+    {
+        if (atlas_page->nodes[i].y > y)
+            y = atlas_page->nodes[i].y;
+
+        if (y + height > (int) atlas_size)
+            return -1;
+
+        remaining -= atlas_page->nodes[i].width;
+    }
+
+    return y;
+}
+
+static unsigned int atlas_page_insert(atlas_page_T* atlas_page, int width, int height, unsigned int atlas_size, int* out_x, int* out_y)
+{
+    int best_y = -1;
+    int best_width = 0;
+    size_t best_index = 0;
+
+    for (size_t i = 0; i < atlas_page->nodes_size; i++)
+    {
+        int y = atlas_page_fit(atlas_page, i, width, height, atlas_size);
+
+        if (y < 0)
+            continue;
+
+        if (best_y < 0 || y < best_y || (y == best_y && atlas_page->nodes[i].width < best_width))
+        {
+            best_y = y;
+            best_width = atlas_page->nodes[i].width;
+            best_index = i;
+        }
+    }
+
+    if (best_y < 0)
+        return 0;
+
+    atlas_skyline_node_T node;
+    node.x = atlas_page->nodes[best_index].x;
+    node.y = best_y + height;
+    node.width = width;
+
+    atlas_page->nodes = realloc(atlas_page->nodes, (atlas_page->nodes_size + 1) * sizeof(struct ATLAS_SKYLINE_NODE_STRUCT));
+    memmove(
+        &atlas_page->nodes[best_index + 1],
+        &atlas_page->nodes[best_index],
+        (atlas_page->nodes_size - best_index) * sizeof(struct ATLAS_SKYLINE_NODE_STRUCT)
+    );
+    atlas_page->nodes[best_index] = node;
+    atlas_page->nodes_size += 1;
+
+    // the new node shadows the start of the nodes after it, trim them
+    for (size_t i = best_index + 1; i < atlas_page->nodes_size; i++)
+    {
+        atlas_skyline_node_T* previous = &atlas_page->nodes[i - 1];
+        atlas_skyline_node_T* current = &atlas_page->nodes[i];
+        int shrink = previous->x + previous->width - current->x;
+
+        if (shrink <= 0)
+            break;
+
+        current->x += shrink;
+        current->width -= shrink;
+
+        if (current->width > 0)
+            break;
+
+        memmove(current, current + 1, (atlas_page->nodes_size - i - 1) * sizeof(struct ATLAS_SKYLINE_NODE_STRUCT));
+        atlas_page->nodes_size -= 1;
+        i -= 1;
+    }
+
+    for (size_t i = 0; i + 1 < atlas_page->nodes_size; i++)
+    {
+        if (atlas_page->nodes[i].y != atlas_page->nodes[i + 1].y)
+            continue;
+
+        atlas_page->nodes[i].width += atlas_page->nodes[i + 1].width;
+        memmove(
+            &atlas_page->nodes[i + 1],
+            &atlas_page->nodes[i + 2],
+            (atlas_page->nodes_size - i - 2) * sizeof(struct ATLAS_SKYLINE_NODE_STRUCT)
+        );
+        atlas_page->nodes_size -= 1;
+        i -= 1;
+    }
+
+    *out_x = node.x;
+    *out_y = best_y;
+
+    return 1;
+}
+
+static void atlas_page_blit(atlas_page_T* atlas_page, texture_T* texture, int x, int y, unsigned int atlas_size)
+{
+    size_t row_bytes = (size_t) texture->width * 4;
+
+    for (int row = 0; row < texture->height; row++)
+    {
+        memcpy(
+            &atlas_page->pixels[(((size_t) (y + row) * atlas_size) + x) * 4],
+            &texture->data[row * row_bytes],
+            row_bytes
+        );
+    }
+}
+
+static int atlas_frame_source_compare(const void* a, const void* b)
+{
+    const atlas_frame_source_T* frame_a = (const atlas_frame_source_T*) a;
+    const atlas_frame_source_T* frame_b = (const atlas_frame_source_T*) b;
+
+    if (frame_a->texture->height != frame_b->texture->height)
+        return frame_b->texture->height - frame_a->texture->height;
+
+    return frame_b->texture->width - frame_a->texture->width;
+}
+
+static dynamic_list_T* database_get_scene_sprites(database_T* database, const char* scene_id)
+{
+    dynamic_list_T* database_sprites = init_dynamic_list(sizeof(struct DATABASE_SPRITE_STRUCT*));
+
+    char* schema = database_get_scene_schema(database, scene_id);
+    char* sql_template =
+        "SELECT DISTINCT actor_definitions.sprite_id FROM %s.actor_instances"
+        " JOIN actor_definitions ON actor_definitions.id = actor_instances.actor_definition_id"
+        " WHERE actor_instances.scene_id=\'%s\'";
+    char* sql = calloc(strlen(sql_template) + strlen(schema) + strlen(scene_id) + 1, sizeof(char));
+    sprintf(sql, sql_template, schema, scene_id);
+    free(schema);
+
+    sqlite3_stmt* stmt = database_exec_scene_sql(database, scene_id, sql, 0);
+    free(sql);
+
+    if (stmt == (void*) 0)
+        return database_sprites;
+
+    dynamic_list_T* sprite_ids = init_dynamic_list(sizeof(char*));
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        dynamic_list_append(sprite_ids, database_intern(database, (const char*) sqlite3_column_text(stmt, 0)));
+
+    database_finalize_scene(database, scene_id, stmt);
+
+    for (int i = 0; i < sprite_ids->size; i++)
+    {
+        database_sprite_T* database_sprite = database_get_sprite_by_id(database, (const char*) sprite_ids->items[i]);
+
+        if (database_sprite != (void*) 0)
+            dynamic_list_append(database_sprites, database_sprite);
+    }
+
+    free(sprite_ids->items);
+    free(sprite_ids);
+
+    return database_sprites;
+}
+
+static void database_delete_scene_atlases(database_T* database, const char* scene_id)
+{
+    char* sql_template = "SELECT filepath FROM atlases WHERE scene_id=\'%s\'";
+    char* sql = calloc(strlen(sql_template) + strlen(scene_id) + 1, sizeof(char));
+    sprintf(sql, sql_template, scene_id);
+
+    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    free(sql);
+
+    dynamic_list_T* filepaths = init_dynamic_list(sizeof(char*));
+
+    while (stmt != (void*) 0 && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* filepath = (const char*) sqlite3_column_text(stmt, 0);
+        char* filepath_new = calloc(strlen(filepath) + 1, sizeof(char));
+        strcpy(filepath_new, filepath);
+        dynamic_list_append(filepaths, filepath_new);
+    }
+
+    database_finalize(database, stmt);
+
+    sql_template = "DELETE FROM atlases WHERE scene_id=\'%s\'; DELETE FROM atlas_frames WHERE scene_id=\'%s\'";
+    sql = calloc(strlen(sql_template) + (strlen(scene_id) * 2) + 1, sizeof(char));
+    sprintf(sql, sql_template, scene_id, scene_id);
+
+    int rc = database_exec_write(database, (void*) 0, sql);
+    free(sql);
+
+    for (int i = 0; i < filepaths->size; i++)
+    {
+        if (rc == SQLITE_OK && access((char*) filepaths->items[i], F_OK) == 0)
+            delete_file((char*) filepaths->items[i]);
+
+        free(filepaths->items[i]);
+    }
+
+    free(filepaths->items);
+    free(filepaths);
+}
+
+typedef struct ATLAS_WRITE_STRUCT
+{
+    const char* scene_id;
+    const char* directory;
+    atlas_page_T** pages;
+    size_t pages_size;
+    atlas_frame_source_T* frames;
+    size_t frames_size;
+    unsigned int atlas_size;
+} atlas_write_T;
+
+static char* database_atlas_filepath(const char* directory, const char* atlas_id)
+{
+    char* filepath = calloc(strlen(directory) + strlen(atlas_id) + strlen(".spr") + 1, sizeof(char));
+    sprintf(filepath, "%s%s.spr", directory, atlas_id);
+
+    return filepath;
+}
+
+static int database_atlas_write_rows(sqlite3* db, void* user_data)
+{
+    atlas_write_T* write = (atlas_write_T*) user_data;
+    sqlite3_stmt* atlas_stmt;
+    sqlite3_stmt* frame_stmt = (void*) 0;
+
+    sqlite3_exec(db, "BEGIN", 0, 0, 0);
+
+    int rc = sqlite3_prepare_v2(db, "INSERT INTO atlases VALUES(?, ?, ?, ?, ?)", -1, &atlas_stmt, NULL);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_prepare_v2(db, "INSERT INTO atlas_frames VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", -1, &frame_stmt, NULL);
+
+    for (size_t i = 0; i < write->pages_size && rc == SQLITE_OK; i++)
+    {
+        char* filepath = database_atlas_filepath(write->directory, write->pages[i]->id);
+
+        sqlite3_bind_text(atlas_stmt, 1, write->pages[i]->id, -1, SQLITE_STATIC);
+        sqlite3_bind_text(atlas_stmt, 2, write->scene_id, -1, SQLITE_STATIC);
+        sqlite3_bind_text(atlas_stmt, 3, filepath, -1, SQLITE_TRANSIENT);
+        free(filepath);
+        sqlite3_bind_int(atlas_stmt, 4, write->atlas_size);
+        sqlite3_bind_int(atlas_stmt, 5, write->atlas_size);
+        rc = sqlite3_step(atlas_stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_reset(atlas_stmt);
+    }
+
+    for (size_t i = 0; i < write->frames_size && rc == SQLITE_OK; i++)
+    {
+        atlas_frame_source_T* frame = &write->frames[i];
+        texture_T* texture = frame->texture;
+        float size = (float) write->atlas_size;
+
+        sqlite3_bind_text(frame_stmt, 1, write->pages[frame->atlas]->id, -1, SQLITE_STATIC);
+        sqlite3_bind_text(frame_stmt, 2, write->scene_id, -1, SQLITE_STATIC);
+        sqlite3_bind_text(frame_stmt, 3, frame->sprite_id, -1, SQLITE_STATIC);
+        sqlite3_bind_int(frame_stmt, 4, frame->frame);
+        sqlite3_bind_int(frame_stmt, 5, frame->x);
+        sqlite3_bind_int(frame_stmt, 6, frame->y);
+        sqlite3_bind_int(frame_stmt, 7, texture->width);
+        sqlite3_bind_int(frame_stmt, 8, texture->height);
+        sqlite3_bind_double(frame_stmt, 9, frame->x / size);
+        sqlite3_bind_double(frame_stmt, 10, frame->y / size);
+        sqlite3_bind_double(frame_stmt, 11, (frame->x + texture->width) / size);
+        sqlite3_bind_double(frame_stmt, 12, (frame->y + texture->height) / size);
+        rc = sqlite3_step(frame_stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_reset(frame_stmt);
+    }
+
+    sqlite3_finalize(atlas_stmt);
+    sqlite3_finalize(frame_stmt);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "COMMIT", 0, 0, 0);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR writing atlases: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+    }
+
+    return rc;
+}
+
+unsigned int database_build_scene_atlases(database_T* database, const char* scene_id, unsigned int atlas_size)
+{
+    database_delete_scene_atlases(database, scene_id);
+
+    dynamic_list_T* database_sprites = database_get_scene_sprites(database, scene_id);
+
+    atlas_frame_source_T* frames = (void*) 0;
+    size_t frames_size = 0;
+
+    for (int i = 0; i < database_sprites->size; i++)
+    {
+        database_sprite_T* database_sprite = (database_sprite_T*) database_sprites->items[i];
+
+        if (database_sprite->sprite == (void*) 0)
+            continue;
+
+        dynamic_list_T* textures = database_sprite->sprite->textures;
+        frames = realloc(frames, (frames_size + textures->size) * sizeof(struct ATLAS_FRAME_SOURCE_STRUCT));
+
+        for (int j = 0; j < textures->size; j++)
+        {
+            texture_T* texture = (texture_T*) textures->items[j];
+
+            if (texture->width + DATABASE_ATLAS_PADDING > (int) atlas_size ||
+                texture->height + DATABASE_ATLAS_PADDING > (int) atlas_size)
+            {
+                printf("Frame %d of sprite %s does not fit in a %u atlas\n", j, database_sprite->name, atlas_size);
+                continue;
+            }
+
+            atlas_frame_source_T* frame = &frames[frames_size++];
+            frame->sprite_id = database_sprite->id;
+            frame->frame = j;
+            frame->texture = texture;
+        }
+    }
+
+    // tallest first keeps the skyline flat
+    if (frames_size > 0)
+        qsort(frames, frames_size, sizeof(struct ATLAS_FRAME_SOURCE_STRUCT), atlas_frame_source_compare);
+
+    atlas_page_T** pages = (void*) 0;
+    size_t pages_size = 0;
+
+    for (size_t i = 0; i < frames_size; i++)
+    {
+        atlas_frame_source_T* frame = &frames[i];
+        int width = frame->texture->width + DATABASE_ATLAS_PADDING;
+        int height = frame->texture->height + DATABASE_ATLAS_PADDING;
+        unsigned int placed = 0;
+
+        for (size_t j = 0; j < pages_size && !placed; j++)
+        {
+            if (atlas_page_insert(pages[j], width, height, atlas_size, &frame->x, &frame->y))
+            {
+                frame->atlas = j;
+                placed = 1;
+            }
+        }
+
+        if (!placed)
+        {
+            pages = realloc(pages, (pages_size + 1) * sizeof(struct ATLAS_PAGE_STRUCT*));
+            pages[pages_size] = init_atlas_page(atlas_size);
+            atlas_page_insert(pages[pages_size], width, height, atlas_size, &frame->x, &frame->y);
+            frame->atlas = pages_size;
+            pages_size += 1;
+        }
+
+        atlas_page_blit(pages[frame->atlas], frame->texture, frame->x, frame->y, atlas_size);
+    }
+
+    mkdir(database->atlases_directory, 0755);
+
+    for (size_t i = 0; i < pages_size; i++)
+    {
+        char* filepath = database_atlas_filepath(database->atlases_directory, pages[i]->id);
+
+        spr_frame_T** spr_frames = calloc(1, sizeof(struct SPR_FRAME_STRUCT*));
+        spr_frames[0] = spr_init_frame_from_data(pages[i]->pixels, atlas_size, atlas_size);
+
+        spr_T* spr = init_spr(atlas_size, atlas_size, 255, 255, 255, 0, 0, spr_frames, 1);
+        spr_write_to_file(spr, filepath);
+        spr_free(spr);
+        free(filepath);
+    }
+
+    atlas_write_T write;
+    write.scene_id = scene_id;
+    write.directory = database->atlases_directory;
+    write.pages = pages;
+    write.pages_size = pages_size;
+    write.frames = frames;
+    write.frames_size = frames_size;
+    write.atlas_size = atlas_size;
+
+    unsigned int written = pages_size == 0 || database_submit_write(database, database_atlas_write_rows, &write) == SQLITE_OK;
+
+    for (size_t i = 0; i < pages_size; i++)
+    {
+        // without their rows the atlas images would never be found nor removed
+        if (!written)
+        {
+            char* filepath = database_atlas_filepath(database->atlases_directory, pages[i]->id);
+            delete_file(filepath);
+            free(filepath);
+        }
+
+        atlas_page_free(pages[i]);
+    }
+
+    for (int i = 0; i < database_sprites->size; i++)
+        database_sprite_free((database_sprite_T*) database_sprites->items[i]);
+
+    free(pages);
+    free(frames);
+    free(database_sprites->items);
+    free(database_sprites);
+
+    return written ? pages_size : 0;
+}
+
+database_atlas_frame_T* database_get_atlas_frame(
+    database_T* database,
+    const char* scene_id,
+    const char* sprite_id,
+    unsigned int frame
+)
+{
+    sqlite3_stmt* stmt = database_exec_sql(
+        database,
+        "SELECT atlas_frames.atlas_id, atlases.filepath, x, y, atlas_frames.width, atlas_frames.height, u0, v0, u1, v1"
+        " FROM atlas_frames JOIN atlases ON atlases.id = atlas_frames.atlas_id"
+        " WHERE atlas_frames.scene_id=? AND sprite_id=? AND frame=? LIMIT 1",
+        0
+    );
+
+    if (stmt == (void*) 0)
+        return (void*) 0;
+
+    sqlite3_bind_text(stmt, 1, scene_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, sprite_id, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, frame);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW)
+    {
+        database_finalize(database, stmt);
+        return (void*) 0;
+    }
+
+    const char* filepath = (const char*) sqlite3_column_text(stmt, 1);
+
+    database_atlas_frame_T* database_atlas_frame = calloc(1, sizeof(struct DATABASE_ATLAS_FRAME_STRUCT));
+    database_atlas_frame->atlas_id = database_intern(database, (const char*) sqlite3_column_text(stmt, 0));
+    database_atlas_frame->filepath = calloc(strlen(filepath) + 1, sizeof(char));
+    strcpy(database_atlas_frame->filepath, filepath);
+    database_atlas_frame->x = sqlite3_column_int(stmt, 2);
+    database_atlas_frame->y = sqlite3_column_int(stmt, 3);
+    database_atlas_frame->width = sqlite3_column_int(stmt, 4);
+    database_atlas_frame->height = sqlite3_column_int(stmt, 5);
+    database_atlas_frame->u0 = sqlite3_column_double(stmt, 6);
+    database_atlas_frame->v0 = sqlite3_column_double(stmt, 7);
+    database_atlas_frame->u1 = sqlite3_column_double(stmt, 8);
+    database_atlas_frame->v1 = sqlite3_column_double(stmt, 9);
+
+    database_finalize(database, stmt);
+
+    return database_atlas_frame;
+}
@@ -0,0 +1,188 @@
+#include "include/database_batch.h"
+#include <coelum/io.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+/**
+ * Rows are selected as "position, <columns>", so every mapper reads the
+ * table columns shifted by one.
+ */
+static void* database_sprite_from_row(database_T* database, sqlite3_stmt* stmt)
+{
+    database_sprite_T* database_sprite = init_database_sprite((void*) 0, (void*) 0, (void*) 0, (void*) 0);
+    database_table_read(stmt, &database_sprites_table, database->intern_table, 1, database_sprite);
+
+    database_sprite_reload(database, database_sprite);
+
+    return database_sprite;
+}
+
+static void* database_script_from_row(database_T* database, sqlite3_stmt* stmt)
+{
+    database_script_T* database_script = init_database_script((void*) 0, (void*) 0, (void*) 0, (void*) 0);
+    database_table_read(stmt, &database_scripts_table, database->intern_table, 1, database_script);
+
+    if (database_script->filepath != (void*) 0)
+        database_script_set_contents(database_script, read_file(database_script->filepath));
+
+    return database_script;
+}
+
+static void* database_actor_definition_from_row(database_T* database, sqlite3_stmt* stmt)
+{
+    database_actor_definition_T* database_actor_definition = init_database_actor_definition(
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0
+    );
+    database_table_read(stmt, &database_actor_definitions_table, database->intern_table, 1, database_actor_definition);
+
+    return database_actor_definition;
+}
+
+/**
+ * Joins the table against the ids as an inline VALUES list, one query per
+ * DATABASE_BATCH_SIZE ids, and stores every mapped row at the position of
+ * the id it was asked for. Positions nothing is asked for are skipped.
+ */
+static void database_get_by_ids(
+    database_T* database,
+    const database_table_T* table,
+    const char** ids,
+    size_t ids_size,
+    void** results,
+    void* (*map_row)(database_T* database, sqlite3_stmt* stmt)
+)
+{
+    for (size_t offset = 0; offset < ids_size; offset += DATABASE_BATCH_SIZE)
+    {
+        size_t batch_size = 0;
+
+        for (size_t i = offset; i < ids_size && i < offset + DATABASE_BATCH_SIZE; i++)
+            batch_size += ids[i] != (void*) 0 && results[i] == (void*) 0;
+
+        if (batch_size == 0)
+            continue;
+
+        char* clause_template = "JOIN (VALUES %s) AS ids ON ids.column1 = %s.id";
+        char* values = calloc((batch_size * strlen("(?, ?), ")) + 1, sizeof(char));
+
+        for (size_t i = 0; i < batch_size; i++)
+            strcat(values, i == 0 ? "(?, ?)" : ", (?, ?)");
+
+        char* clause = calloc(strlen(clause_template) + strlen(values) + strlen(table->name) + 1, sizeof(char));
+        sprintf(clause, clause_template, values, table->name);
+        free(values);
+
+        char* sql = database_table_select_sql(table, (void*) 0, "ids.column2", clause);
+        free(clause);
+
+        sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+        free(sql);
+
+        if (stmt == (void*) 0)
+            return;
+
+        int parameter = 1;
+
+        for (size_t i = offset; i < ids_size && i < offset + DATABASE_BATCH_SIZE; i++)
+        {
+            if (ids[i] == (void*) 0 || results[i] != (void*) 0)
+                continue;
+
+            sqlite3_bind_text(stmt, parameter++, ids[i], -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, parameter++, i);
+        }
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            size_t position = sqlite3_column_int64(stmt, 0);
+
+            // ids are not unique in the schema, the first row wins
+            if (results[position] == (void*) 0)
+                results[position] = map_row(database, stmt);
+        }
+
+        database_finalize(database, stmt);
+    }
+}
+
+static dynamic_list_T* database_results_to_list(void** results, size_t results_size, size_t item_size)
+{
+    dynamic_list_T* list = init_dynamic_list(item_size);
+
+    for (size_t i = 0; i < results_size; i++)
+        dynamic_list_append(list, results[i]);
+
+    free(results);
+
+    return list;
+}
+
+dynamic_list_T* database_get_sprites_by_ids(database_T* database, const char** ids, size_t ids_size)
+{
+    void** results = calloc(ids_size, sizeof(void*));
+    database_get_by_ids(database, &database_sprites_table, ids, ids_size, results, database_sprite_from_row);
+
+    return database_results_to_list(results, ids_size, sizeof(struct DATABASE_SPRITE_STRUCT*));
+}
+
+dynamic_list_T* database_get_scripts_by_ids(database_T* database, const char** ids, size_t ids_size)
+{
+    void** results = calloc(ids_size, sizeof(void*));
+    database_get_by_ids(database, &database_scripts_table, ids, ids_size, results, database_script_from_row);
+
+    return database_results_to_list(results, ids_size, sizeof(struct DATABASE_SCRIPT_STRUCT*));
+}
+
+/**
+ * Cached definitions are served from the definition cache, the rest are
+ * loaded with one query per batch.
+ */
+dynamic_list_T* database_get_actor_definitions_by_ids(database_T* database, const char** ids, size_t ids_size)
+{
+    database_actor_definition_T** results = calloc(ids_size, sizeof(struct DATABASE_ACTOR_DEFINITION_STRUCT*));
+    unsigned int* loaded = calloc(ids_size, sizeof(unsigned int));
+    unsigned long generation = definition_cache_generation(database->definition_cache);
+
+    for (size_t i = 0; i < ids_size; i++)
+    {
+        if (ids[i] != (void*) 0)
+            results[i] = definition_cache_get_by_id(
+                database->definition_cache,
+                intern_table_find(database->intern_table, ids[i])
+            );
+
+        loaded[i] = results[i] == (void*) 0;
+    }
+
+    database_get_by_ids(database, &database_actor_definitions_table, ids, ids_size, (void**) results, database_actor_definition_from_row);
+
+    for (size_t i = 0; i < ids_size; i++)
+    {
+        if (!loaded[i] || results[i] == (void*) 0)
+            continue;
+
+        // an id asked for twice was put into the cache by its first position
+        database_actor_definition_T* cached = definition_cache_get_by_id(database->definition_cache, results[i]->id);
+
+        if (cached != (void*) 0)
+        {
+            database_actor_definition_free(results[i]);
+            results[i] = cached;
+            continue;
+        }
+
+        definition_cache_put(database->definition_cache, results[i], generation);
+    }
+
+    free(loaded);
+
+    return database_results_to_list((void**) results, ids_size, sizeof(struct DATABASE_ACTOR_DEFINITION_STRUCT*));
+}
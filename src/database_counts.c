@@ -0,0 +1,130 @@
+#include "include/database_counts.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+database_count_T* init_database_count(char* id, unsigned int count)
+{
+    database_count_T* database_count = calloc(1, sizeof(struct DATABASE_COUNT_STRUCT));
+    database_count->id = id;
+    database_count->count = count;
+
+    return database_count;
+}
+
+void database_count_free(database_count_T* database_count)
+{
+    free(database_count);
+}
+
+/**
+ * Both the counts and the grouped rows are ordered by id, so adding a
+ * grouped result in is a single merge walk.
+ */
+static void database_counts_add(
+    database_T* database,
+    dynamic_list_T* database_counts,
+    const char* schema,
+    const char* scene_id,
+    const char* sql_template
+)
+{
+    char* sql = calloc(strlen(sql_template) + strlen(schema) + 1, sizeof(char));
+    sprintf(sql, sql_template, schema);
+
+    sqlite3_stmt* stmt = database_exec_scene_sql(database, scene_id, sql, 0);
+    free(sql);
+
+    if (stmt == (void*) 0)
+        return;
+
+    int i = 0;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* id = (const char*) sqlite3_column_text(stmt, 0);
+
+        if (id == (void*) 0)
+            continue;
+
+        while (i < database_counts->size && strcmp(((database_count_T*) database_counts->items[i])->id, id) < 0)
+            i++;
+
+        if (i < database_counts->size && strcmp(((database_count_T*) database_counts->items[i])->id, id) == 0)
+            ((database_count_T*) database_counts->items[i])->count += sqlite3_column_int(stmt, 1);
+    }
+
+    database_finalize_scene(database, scene_id, stmt);
+}
+
+static dynamic_list_T* database_count_actors_per(database_T* database, const char* table, const char* sql_template)
+{
+    dynamic_list_T* database_counts = init_dynamic_list(sizeof(struct DATABASE_COUNT_STRUCT*));
+
+    // the merge in database_counts_add compares ids, a row without one
+    // has nothing to be counted under
+    char* sql = calloc(strlen("SELECT DISTINCT id FROM  WHERE id IS NOT NULL ORDER BY id") + strlen(table) + 1, sizeof(char));
+    sprintf(sql, "SELECT DISTINCT id FROM %s WHERE id IS NOT NULL ORDER BY id", table);
+
+    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    free(sql);
+
+    while (stmt != (void*) 0 && sqlite3_step(stmt) == SQLITE_ROW)
+        dynamic_list_append(database_counts, init_database_count(database_column_intern(database, stmt, 0), 0));
+
+    database_finalize(database, stmt);
+
+    if (!(database->flags & DATABASE_SHARD_SCENES))
+    {
+        database_counts_add(database, database_counts, "main", (void*) 0, sql_template);
+        return database_counts;
+    }
+
+    dynamic_list_T* database_scenes = database_get_all_scenes(database);
+
+    for (int i = 0; i < database_scenes->size; i++)
+    {
+        database_scene_T* database_scene = (database_scene_T*) database_scenes->items[i];
+        char* schema = database_get_scene_schema(database, database_scene->id);
+
+        database_counts_add(database, database_counts, schema, database_scene->id, sql_template);
+
+        free(schema);
+        database_scene_free(database_scene);
+    }
+
+    free(database_scenes->items);
+    free(database_scenes);
+
+    return database_counts;
+}
+
+dynamic_list_T* database_count_actors_per_scene(database_T* database)
+{
+    return database_count_actors_per(
+        database,
+        "scenes",
+        "SELECT scene_id, count(*) FROM %s.actor_instances GROUP BY scene_id ORDER BY scene_id"
+    );
+}
+
+dynamic_list_T* database_count_actors_per_actor_definition(database_T* database)
+{
+    return database_count_actors_per(
+        database,
+        "actor_definitions",
+        "SELECT actor_definition_id, count(*) FROM %s.actor_instances GROUP BY actor_definition_id ORDER BY actor_definition_id"
+    );
+}
+
+dynamic_list_T* database_count_actors_per_sprite(database_T* database)
+{
+    return database_count_actors_per(
+        database,
+        "sprites",
+        "SELECT actor_definitions.sprite_id, count(*) FROM %s.actor_instances"
+        " JOIN actor_definitions ON actor_definitions.id = actor_instances.actor_definition_id"
+        " GROUP BY actor_definitions.sprite_id ORDER BY actor_definitions.sprite_id"
+    );
+}
@@ -0,0 +1,473 @@
+#include "include/database_frames.h"
+#include "include/file_utils.h"
+#include <spr/spr.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DATABASE_FRAME_HASH_OFFSET 0xcbf29ce484222325ULL
+#define DATABASE_FRAME_HASH_PRIME 0x100000001b3ULL
+#define DATABASE_FRAME_HASH_LANES 4
+
+
+/**
+ * FNV-1a folding in a whole 64 bit word per round, spread over independent
+ * lanes so consecutive rounds do not wait on each other's multiply.
+ * This is scalar code, there is no vector 64 bit multiply to map it to;
+ * the conversion of the pixels themselves is spr_init_frame_from_data's.
+ */
+uint64_t database_frame_hash(texture_T* texture)
+{
+    size_t size = (size_t) texture->width * texture->height * 4;
+    const unsigned char* data = (const unsigned char*) texture->data;
+    uint64_t lanes[DATABASE_FRAME_HASH_LANES];
+    uint64_t hash = DATABASE_FRAME_HASH_OFFSET;
+    size_t i = 0;
+
+    for (int lane = 0; lane < DATABASE_FRAME_HASH_LANES; lane++)
+        lanes[lane] = DATABASE_FRAME_HASH_OFFSET + lane;
+
+    for (; i + sizeof(lanes) <= size; i += sizeof(lanes))
+    {
+        uint64_t words[DATABASE_FRAME_HASH_LANES];
+        memcpy(words, &data[i], sizeof(words));
+
+        for (int lane = 0; lane < DATABASE_FRAME_HASH_LANES; lane++)
+        {
+            lanes[lane] = (lanes[lane] ^ words[lane]) * DATABASE_FRAME_HASH_PRIME;
+            lanes[lane] ^= lanes[lane] >> 32;
+        }
+    }
+
+    hash = (hash ^ (uint64_t) texture->width) * DATABASE_FRAME_HASH_PRIME;
+    hash = (hash ^ (uint64_t) texture->height) * DATABASE_FRAME_HASH_PRIME;
+
+    for (int lane = 0; lane < DATABASE_FRAME_HASH_LANES; lane++)
+        hash = (hash ^ lanes[lane]) * DATABASE_FRAME_HASH_PRIME;
+
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * DATABASE_FRAME_HASH_PRIME;
+
+    return hash;
+}
+
+static void database_frame_key(uint64_t hash, char* key)
+{
+    sprintf(key, "%016" PRIx64, hash);
+}
+
+static char* database_frame_filepath(const char* directory, const char* key)
+{
+    char* filepath = calloc(strlen(directory) + strlen(key) + strlen(".spr") + 1, sizeof(char));
+    sprintf(filepath, "%s%s.spr", directory, key);
+
+    return filepath;
+}
+
+/**
+ * Written next to its final name and renamed into place, so concurrent
+ * encoders of the same frame never expose a half written file.
+ */
+static void database_frame_write_file(const char* filepath, texture_T* texture)
+{
+    char* temporary_filepath = calloc(strlen(filepath) + 2 + sizeof(unsigned long) * 2 + 1, sizeof(char));
+    sprintf(temporary_filepath, "%s.%lx", filepath, (unsigned long) pthread_self());
+
+    spr_frame_T** frames = calloc(1, sizeof(struct SPR_FRAME_STRUCT*));
+    frames[0] = spr_init_frame_from_data(texture->data, texture->width, texture->height);
+
+    spr_T* spr = init_spr(texture->width, texture->height, 255, 255, 255, 0, 0, frames, 1);
+    spr_write_to_file(spr, temporary_filepath);
+    spr_free(spr);
+
+    rename(temporary_filepath, filepath);
+    free(temporary_filepath);
+}
+
+typedef struct DATABASE_FRAME_ENCODER_STRUCT
+{
+    const char* directory;
+    dynamic_list_T* textures;
+    uint64_t* hashes;
+    atomic_size_t next;
+    // pool threads currently encoding its frames
+    unsigned int workers;
+    unsigned int queued;
+    struct DATABASE_FRAME_ENCODER_STRUCT* next_encoder;
+} database_frame_encoder_T;
+
+static void database_frame_encoder_run(database_frame_encoder_T* encoder)
+{
+    size_t i;
+
+    while ((i = atomic_fetch_add(&encoder->next, 1)) < encoder->textures->size)
+    {
+        texture_T* texture = (texture_T*) encoder->textures->items[i];
+        char key[17];
+
+        encoder->hashes[i] = database_frame_hash(texture);
+        database_frame_key(encoder->hashes[i], key);
+        char* filepath = database_frame_filepath(encoder->directory, key);
+
+        if (access(filepath, F_OK) != 0)
+            database_frame_write_file(filepath, texture);
+
+        free(filepath);
+    }
+}
+
+/**
+ * Must be called with the pool locked.
+ */
+static void database_frame_pool_unqueue(database_frame_pool_T* pool, database_frame_encoder_T* encoder)
+{
+    if (!encoder->queued)
+        return;
+
+    database_frame_encoder_T** link = &pool->encoders;
+
+    while (*link != encoder)
+        link = &(*link)->next_encoder;
+
+    *link = encoder->next_encoder;
+    encoder->queued = 0;
+}
+
+static void* database_frame_pool_thread(void* arg)
+{
+    database_frame_pool_T* pool = (database_frame_pool_T*) arg;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (!pool->stopping)
+    {
+        database_frame_encoder_T* encoder = pool->encoders;
+
+        if (encoder == (void*) 0)
+        {
+            pthread_cond_wait(&pool->queued, &pool->lock);
+            continue;
+        }
+
+        encoder->workers += 1;
+        pthread_mutex_unlock(&pool->lock);
+
+        database_frame_encoder_run(encoder);
+
+        pthread_mutex_lock(&pool->lock);
+
+        // every frame is handed out, nobody else needs to join
+        database_frame_pool_unqueue(pool, encoder);
+        encoder->workers -= 1;
+        pthread_cond_broadcast(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return (void*) 0;
+}
+
+database_frame_pool_T* init_database_frame_pool()
+{
+    database_frame_pool_T* pool = calloc(1, sizeof(struct DATABASE_FRAME_POOL_STRUCT));
+    pthread_mutex_init(&pool->lock, (void*) 0);
+    pthread_cond_init(&pool->queued, (void*) 0);
+    pthread_cond_init(&pool->done, (void*) 0);
+
+    return pool;
+}
+
+void database_frame_pool_free(database_frame_pool_T* pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->queued);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 0; i < pool->threads_size; i++)
+        pthread_join(pool->threads[i], (void*) 0);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->queued);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+}
+
+/**
+ * Threads are started the first time frames are encoded and then kept,
+ * the calling thread is always one of the encoders.
+ */
+void database_encode_sprite_frames(database_T* database, dynamic_list_T* textures, uint64_t* hashes)
+{
+    database_frame_pool_T* pool = database->frame_pool;
+    database_frame_encoder_T encoder;
+    encoder.directory = database->frames_directory;
+    encoder.textures = textures;
+    encoder.hashes = hashes;
+    encoder.workers = 0;
+    encoder.queued = 0;
+    encoder.next_encoder = (void*) 0;
+    atomic_init(&encoder.next, 0);
+
+    mkdir(database->frames_directory, 0755);
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (!pool->started)
+    {
+        long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (thread_count > DATABASE_FRAME_ENCODE_THREADS)
+            thread_count = DATABASE_FRAME_ENCODE_THREADS;
+
+        for (long i = 0; i < thread_count - 1; i++)
+        {
+            if (pthread_create(&pool->threads[pool->threads_size], (void*) 0, database_frame_pool_thread, pool) == 0)
+                pool->threads_size++;
+        }
+
+        pool->started = 1;
+    }
+
+    if (pool->threads_size > 0 && textures->size > 1)
+    {
+        database_frame_encoder_T** link = &pool->encoders;
+
+        while (*link != (void*) 0)
+            link = &(*link)->next_encoder;
+
+        *link = &encoder;
+        encoder.queued = 1;
+        pthread_cond_broadcast(&pool->queued);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    database_frame_encoder_run(&encoder);
+
+    pthread_mutex_lock(&pool->lock);
+    database_frame_pool_unqueue(pool, &encoder);
+
+    while (encoder.workers > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int database_store_sprite_frames(sqlite3* db, const char* directory, const char* sprite_id, dynamic_list_T* textures, uint64_t* hashes)
+{
+    sqlite3_stmt* find_stmt;
+    sqlite3_stmt* frame_stmt;
+    sqlite3_stmt* reference_stmt;
+
+    sqlite3_prepare_v2(db, "SELECT width, height FROM frames WHERE hash=?", -1, &find_stmt, NULL);
+    sqlite3_prepare_v2(db, "INSERT INTO frames VALUES(?, ?, ?, ?, 1) ON CONFLICT(hash) DO UPDATE SET refcount = refcount + 1", -1, &frame_stmt, NULL);
+    sqlite3_prepare_v2(db, "INSERT INTO sprite_frames VALUES(?, ?, ?)", -1, &reference_stmt, NULL);
+
+    mkdir(directory, 0755);
+
+    int rc = SQLITE_OK;
+
+    for (int i = 0; i < textures->size && rc == SQLITE_OK; i++)
+    {
+        texture_T* texture = (texture_T*) textures->items[i];
+        char key[17];
+        char* filepath = (void*) 0;
+
+        // frames are told apart by their 64 bit hash and size alone, the
+        // writer never decodes a stored frame to compare pixels; a frame of
+        // another size already sitting on this hash moves us to the next one
+        while (1)
+        {
+            database_frame_key(hashes[i], key);
+            free(filepath);
+            filepath = database_frame_filepath(directory, key);
+
+            sqlite3_bind_text(find_stmt, 1, key, -1, SQLITE_STATIC);
+            unsigned int exists = sqlite3_step(find_stmt) == SQLITE_ROW;
+            unsigned int matches = exists &&
+                sqlite3_column_int(find_stmt, 0) == texture->width &&
+                sqlite3_column_int(find_stmt, 1) == texture->height;
+            sqlite3_reset(find_stmt);
+
+            if (!exists)
+            {
+                // normally already written by database_encode_sprite_frames
+                if (access(filepath, F_OK) != 0)
+                    database_frame_write_file(filepath, texture);
+
+                break;
+            }
+
+            if (matches)
+                break;
+
+            hashes[i] += 1;
+        }
+
+        sqlite3_bind_text(frame_stmt, 1, key, -1, SQLITE_STATIC);
+        sqlite3_bind_text(frame_stmt, 2, filepath, -1, SQLITE_STATIC);
+        sqlite3_bind_int(frame_stmt, 3, texture->width);
+        sqlite3_bind_int(frame_stmt, 4, texture->height);
+        rc = sqlite3_step(frame_stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_reset(frame_stmt);
+        free(filepath);
+
+        sqlite3_bind_text(reference_stmt, 1, sprite_id, -1, SQLITE_STATIC);
+        sqlite3_bind_int(reference_stmt, 2, i);
+        sqlite3_bind_text(reference_stmt, 3, key, -1, SQLITE_STATIC);
+
+        if (rc == SQLITE_OK)
+            rc = sqlite3_step(reference_stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+
+        sqlite3_reset(reference_stmt);
+    }
+
+    if (rc != SQLITE_OK)
+        printf("ERROR storing frames: %s\n", sqlite3_errmsg(db));
+
+    sqlite3_finalize(find_stmt);
+    sqlite3_finalize(frame_stmt);
+    sqlite3_finalize(reference_stmt);
+
+    return rc;
+}
+
+void database_discard_sprite_frames(sqlite3* db, const char* directory, dynamic_list_T* textures, uint64_t* hashes)
+{
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM frames WHERE hash=?", -1, &stmt, NULL) != SQLITE_OK)
+        return;
+
+    for (int i = 0; i < textures->size; i++)
+    {
+        char key[17];
+
+        database_frame_key(hashes[i], key);
+        char* filepath = database_frame_filepath(directory, key);
+
+        sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+        unsigned int referenced = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_reset(stmt);
+
+        if (!referenced && access(filepath, F_OK) == 0)
+            delete_file(filepath);
+
+        free(filepath);
+    }
+
+    sqlite3_finalize(stmt);
+}
+
+int database_release_sprite_frames(sqlite3* db, const char* sprite_id, dynamic_list_T* released_filepaths)
+{
+    sqlite3_stmt* stmt;
+
+    sqlite3_prepare_v2(
+        db,
+        "UPDATE frames SET refcount = refcount -"
+        " (SELECT COUNT(*) FROM sprite_frames WHERE sprite_id=?1 AND sprite_frames.hash=frames.hash)"
+        " WHERE hash IN (SELECT hash FROM sprite_frames WHERE sprite_id=?1)",
+        -1,
+        &stmt,
+        NULL
+    );
+    sqlite3_bind_text(stmt, 1, sprite_id, -1, SQLITE_STATIC);
+    int rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR releasing frames: %s\n", sqlite3_errmsg(db));
+        return rc;
+    }
+
+    sqlite3_prepare_v2(db, "SELECT filepath FROM frames WHERE refcount <= 0", -1, &stmt, NULL);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* filepath = (const char*) sqlite3_column_text(stmt, 0);
+        char* released_filepath = calloc(strlen(filepath) + 1, sizeof(char));
+        strcpy(released_filepath, filepath);
+        dynamic_list_append(released_filepaths, released_filepath);
+    }
+
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(db, "DELETE FROM sprite_frames WHERE sprite_id=?", -1, &stmt, NULL);
+    sqlite3_bind_text(stmt, 1, sprite_id, -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    return sqlite3_exec(db, "DELETE FROM frames WHERE refcount <= 0", 0, 0, 0);
+}
+
+void database_delete_frame_files(dynamic_list_T* filepaths, unsigned int delete)
+{
+    for (size_t i = 0; i < filepaths->size; i++)
+    {
+        char* filepath = (char*) filepaths->items[i];
+
+        if (delete && access(filepath, F_OK) == 0)
+            delete_file(filepath);
+
+        free(filepath);
+    }
+
+    free(filepaths->items);
+    free(filepaths);
+}
+
+sprite_T* database_load_sprite_frames(database_T* database, const char* sprite_id)
+{
+    sqlite3_stmt* stmt = database_exec_sql(
+        database,
+        "SELECT frames.filepath, sprites.width, sprites.height, sprites.frame_delay, sprites.animate"
+        " FROM sprite_frames"
+        " JOIN frames ON frames.hash = sprite_frames.hash"
+        " JOIN sprites ON sprites.id = sprite_frames.sprite_id"
+        " WHERE sprite_frames.sprite_id=? ORDER BY sprite_frames.frame",
+        0
+    );
+
+    if (stmt == (void*) 0)
+        return (void*) 0;
+
+    sqlite3_bind_text(stmt, 1, sprite_id, -1, SQLITE_STATIC);
+
+    sprite_T* sprite = (void*) 0;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        sprite_T* frame_sprite = load_sprite_from_disk((const char*) sqlite3_column_text(stmt, 0));
+
+        if (frame_sprite == (void*) 0)
+            continue;
+
+        if (sprite == (void*) 0)
+        {
+            // the first frame's sprite becomes the sprite, the rest hand their texture over
+            sprite = frame_sprite;
+            sprite->width = sqlite3_column_int(stmt, 1);
+            sprite->height = sqlite3_column_int(stmt, 2);
+            sprite->frame_delay = sqlite3_column_double(stmt, 3);
+            sprite->animate = sqlite3_column_int(stmt, 4);
+            continue;
+        }
+
+        for (int i = 0; i < frame_sprite->textures->size; i++)
+            dynamic_list_append(sprite->textures, frame_sprite->textures->items[i]);
+
+        frame_sprite->textures->size = 0;
+        sprite_free(frame_sprite);
+    }
+
+    database_finalize(database, stmt);
+
+    return sprite;
+}
@@ -0,0 +1,46 @@
+#include "include/database_memory.h"
+#include <stdatomic.h>
+
+
+static _Atomic size_t database_memory_current[DATABASE_MEMORY_CATEGORIES];
+static _Atomic size_t database_memory_peak[DATABASE_MEMORY_CATEGORIES];
+static _Atomic size_t database_memory_allocations[DATABASE_MEMORY_CATEGORIES];
+static _Atomic size_t database_memory_live[DATABASE_MEMORY_CATEGORIES];
+
+void database_memory_track_alloc(int category, size_t bytes)
+{
+    size_t current = atomic_fetch_add(&database_memory_current[category], bytes) + bytes;
+    size_t peak = atomic_load(&database_memory_peak[category]);
+
+    while (current > peak && !atomic_compare_exchange_weak(&database_memory_peak[category], &peak, current));
+
+    atomic_fetch_add(&database_memory_allocations[category], 1);
+    atomic_fetch_add(&database_memory_live[category], 1);
+}
+
+void database_memory_track_free(int category, size_t bytes)
+{
+    atomic_fetch_sub(&database_memory_current[category], bytes);
+    atomic_fetch_sub(&database_memory_live[category], 1);
+}
+
+void database_get_memory_stats(database_memory_stats_T* stats)
+{
+    for (int i = 0; i < DATABASE_MEMORY_CATEGORIES; i++)
+    {
+        stats[i].current_bytes = atomic_load(&database_memory_current[i]);
+        stats[i].peak_bytes = atomic_load(&database_memory_peak[i]);
+        stats[i].allocations = atomic_load(&database_memory_allocations[i]);
+        stats[i].live = atomic_load(&database_memory_live[i]);
+    }
+}
+
+const char* database_memory_category_name(int category)
+{
+    const char* names[DATABASE_MEMORY_CATEGORIES] = { "strings", "entities", "sprite pixels", "scripts" };
+
+    if (category < 0 || category >= DATABASE_MEMORY_CATEGORIES)
+        return "unknown";
+
+    return names[category];
+}
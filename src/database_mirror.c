@@ -0,0 +1,296 @@
+#include "include/database_mirror.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define DATABASE_MIRROR_INSERT 0
+#define DATABASE_MIRROR_UPDATE 1
+#define DATABASE_MIRROR_DELETE 2
+
+
+/**
+ * athena_mirror(kind, table, old_rowid, new_rowid, column values...),
+ * called by the triggers for every row they see change.
+ */
+static void database_mirror_apply(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+    database_mirror_T* database_mirror = (database_mirror_T*) sqlite3_user_data(context);
+    int kind = sqlite3_value_int(argv[0]);
+    int table = sqlite3_value_int(argv[1]);
+
+    if (table < 0 || (size_t) table >= database_mirror->tables_size)
+    {
+        sqlite3_result_error(context, "no such mirrored table", -1);
+        return;
+    }
+
+    sqlite3* db = database_mirror->db;
+
+    if (sqlite3_get_autocommit(db) && sqlite3_exec(db, "BEGIN", 0, 0, 0) != SQLITE_OK)
+    {
+        sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+        return;
+    }
+
+    database_mirror_table_T* mirror_table = &database_mirror->tables[table];
+    sqlite3_stmt* stmt;
+
+    if (kind == DATABASE_MIRROR_INSERT)
+    {
+        stmt = mirror_table->insert_stmt;
+
+        for (int i = 3; i < argc; i++)
+            sqlite3_bind_value(stmt, i - 2, argv[i]);
+    }
+    else if (kind == DATABASE_MIRROR_UPDATE)
+    {
+        stmt = mirror_table->update_stmt;
+
+        for (int i = 3; i < argc; i++)
+            sqlite3_bind_value(stmt, i - 2, argv[i]);
+
+        sqlite3_bind_value(stmt, argc - 2, argv[2]);
+    }
+    else
+    {
+        stmt = mirror_table->delete_stmt;
+        sqlite3_bind_value(stmt, 1, argv[2]);
+    }
+
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+        sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+    else
+        sqlite3_result_null(context);
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+/**
+ * Commits the copy first, a copy that cannot commit turns the source's
+ * commit into a rollback.
+ */
+static int database_mirror_commit(void* user_data)
+{
+    database_mirror_T* database_mirror = (database_mirror_T*) user_data;
+
+    if (sqlite3_get_autocommit(database_mirror->db))
+        return 0;
+
+    if (sqlite3_exec(database_mirror->db, "COMMIT", 0, 0, 0) == SQLITE_OK)
+        return 0;
+
+    printf("ERROR mirroring write: %s\n", sqlite3_errmsg(database_mirror->db));
+    sqlite3_exec(database_mirror->db, "ROLLBACK", 0, 0, 0);
+
+    return 1;
+}
+
+static void database_mirror_rollback(void* user_data)
+{
+    database_mirror_T* database_mirror = (database_mirror_T*) user_data;
+
+    if (!sqlite3_get_autocommit(database_mirror->db))
+        sqlite3_exec(database_mirror->db, "ROLLBACK", 0, 0, 0);
+}
+
+/**
+ * Appends format with every column of columns, separated by ", ".
+ */
+static void database_mirror_append_columns(char* sql, char** columns, size_t columns_size, const char* format)
+{
+    for (size_t i = 0; i < columns_size; i++)
+    {
+        if (i > 0)
+            strcat(sql, ", ");
+
+        sprintf(sql + strlen(sql), format, columns[i], columns[i]);
+    }
+}
+
+/**
+ * Prepares the statements replaying rows of table into the copy and creates
+ * the triggers handing them over.
+ */
+static int database_mirror_table(database_mirror_T* database_mirror, sqlite3* db, const char* table, int index)
+{
+    sqlite3_stmt* stmt;
+    char** columns = (void*) 0;
+    size_t columns_size = 0;
+    size_t columns_length = 0;
+
+    int rc = sqlite3_prepare_v2(db, "SELECT name FROM pragma_table_info(?1)", -1, &stmt, NULL);
+
+    if (rc != SQLITE_OK)
+        return rc;
+
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* column = (const char*) sqlite3_column_text(stmt, 0);
+
+        columns = realloc(columns, (columns_size + 1) * sizeof(char*));
+        columns[columns_size] = calloc(strlen(column) + 1, sizeof(char));
+        strcpy(columns[columns_size++], column);
+        columns_length += strlen(column);
+    }
+
+    sqlite3_finalize(stmt);
+
+    char* sql = calloc(512 + strlen(table) * 4 + (columns_length + 16) * 2 * (columns_size + 1), sizeof(char));
+    database_mirror_table_T* mirror_table = &database_mirror->tables[index];
+
+    sprintf(sql, "INSERT OR REPLACE INTO \"%s\"(rowid", table);
+
+    for (size_t i = 0; i < columns_size; i++)
+        sprintf(sql + strlen(sql), ", \"%s\"", columns[i]);
+
+    strcat(sql, ") VALUES(?");
+
+    for (size_t i = 0; i < columns_size; i++)
+        strcat(sql, ", ?");
+
+    strcat(sql, ")");
+    rc = sqlite3_prepare_v2(database_mirror->db, sql, -1, &mirror_table->insert_stmt, NULL);
+
+    if (rc == SQLITE_OK)
+    {
+        sprintf(sql, "UPDATE \"%s\" SET rowid = ?", table);
+
+        for (size_t i = 0; i < columns_size; i++)
+            sprintf(sql + strlen(sql), ", \"%s\" = ?", columns[i]);
+
+        strcat(sql, " WHERE rowid = ?");
+        rc = sqlite3_prepare_v2(database_mirror->db, sql, -1, &mirror_table->update_stmt, NULL);
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        sprintf(sql, "DELETE FROM \"%s\" WHERE rowid = ?", table);
+        rc = sqlite3_prepare_v2(database_mirror->db, sql, -1, &mirror_table->delete_stmt, NULL);
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        sprintf(
+            sql,
+            "CREATE TEMP TRIGGER \"%s_mirror_insert\" AFTER INSERT ON main.\"%s\" BEGIN "
+            "SELECT athena_mirror(%d, %d, NULL, new.rowid%s",
+            table, table, DATABASE_MIRROR_INSERT, index, columns_size > 0 ? ", " : ""
+        );
+        database_mirror_append_columns(sql, columns, columns_size, "new.\"%s\"");
+        rc = sqlite3_exec(db, strcat(sql, "); END;"), 0, 0, 0);
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        sprintf(
+            sql,
+            "CREATE TEMP TRIGGER \"%s_mirror_update\" AFTER UPDATE ON main.\"%s\" BEGIN "
+            "SELECT athena_mirror(%d, %d, old.rowid, new.rowid%s",
+            table, table, DATABASE_MIRROR_UPDATE, index, columns_size > 0 ? ", " : ""
+        );
+        database_mirror_append_columns(sql, columns, columns_size, "new.\"%s\"");
+        rc = sqlite3_exec(db, strcat(sql, "); END;"), 0, 0, 0);
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        sprintf(
+            sql,
+            "CREATE TEMP TRIGGER \"%s_mirror_delete\" AFTER DELETE ON main.\"%s\" BEGIN "
+            "SELECT athena_mirror(%d, %d, old.rowid, NULL); END;",
+            table, table, DATABASE_MIRROR_DELETE, index
+        );
+        rc = sqlite3_exec(db, sql, 0, 0, 0);
+    }
+
+    for (size_t i = 0; i < columns_size; i++)
+        free(columns[i]);
+
+    free(columns);
+    free(sql);
+
+    return rc;
+}
+
+database_mirror_T* init_database_mirror(sqlite3* db, sqlite3* copy_db)
+{
+    database_mirror_T* database_mirror = calloc(1, sizeof(struct DATABASE_MIRROR_STRUCT));
+    database_mirror->db = copy_db;
+
+    // tables the triggers insert into are filled by the copy's own triggers,
+    // virtual tables along with their shadow tables by their module
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(
+        db,
+        "SELECT name FROM main.sqlite_master AS t WHERE type = 'table'"
+        " AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\' AND sql NOT LIKE 'CREATE VIRTUAL%'"
+        " AND NOT EXISTS (SELECT 1 FROM main.sqlite_master AS v WHERE v.type = 'table'"
+        " AND v.sql LIKE 'CREATE VIRTUAL%' AND t.name LIKE v.name || '\\_%' ESCAPE '\\')"
+        " AND NOT EXISTS (SELECT 1 FROM main.sqlite_master AS r WHERE r.type = 'trigger'"
+        " AND r.sql LIKE '%INSERT INTO ' || t.name || '(%')",
+        -1,
+        &stmt,
+        NULL
+    );
+
+    char** tables = (void*) 0;
+    size_t tables_size = 0;
+
+    // creating the triggers changes the schema the select reads
+    while (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* table = (const char*) sqlite3_column_text(stmt, 0);
+
+        tables = realloc(tables, (tables_size + 1) * sizeof(char*));
+        tables[tables_size] = calloc(strlen(table) + 1, sizeof(char));
+        strcpy(tables[tables_size++], table);
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "athena_mirror", -1, SQLITE_UTF8, database_mirror, database_mirror_apply, NULL, NULL);
+
+    database_mirror->tables = calloc(tables_size, sizeof(struct DATABASE_MIRROR_TABLE_STRUCT));
+    database_mirror->tables_size = tables_size;
+
+    for (size_t i = 0; i < tables_size; i++)
+    {
+        if (rc == SQLITE_OK)
+            rc = database_mirror_table(database_mirror, db, tables[i], i);
+
+        free(tables[i]);
+    }
+
+    free(tables);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR mirroring writes: %s\n", sqlite3_errmsg(db));
+        database_mirror_free(database_mirror);
+
+        return (void*) 0;
+    }
+
+    sqlite3_commit_hook(db, database_mirror_commit, database_mirror);
+    sqlite3_rollback_hook(db, database_mirror_rollback, database_mirror);
+
+    return database_mirror;
+}
+
+void database_mirror_free(database_mirror_T* database_mirror)
+{
+    for (size_t i = 0; i < database_mirror->tables_size; i++)
+    {
+        sqlite3_finalize(database_mirror->tables[i].insert_stmt);
+        sqlite3_finalize(database_mirror->tables[i].update_stmt);
+        sqlite3_finalize(database_mirror->tables[i].delete_stmt);
+    }
+
+    sqlite3_close(database_mirror->db);
+    free(database_mirror->tables);
+    free(database_mirror);
+}
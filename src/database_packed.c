@@ -0,0 +1,405 @@
+#include "include/database_packed.h"
+#include "include/database_memory.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+void database_packed_scene_free(database_packed_scene_T* database_packed_scene)
+{
+    database_memory_track_free(
+        DATABASE_MEMORY_ENTITIES,
+        database_packed_scene->actor_definition_ids_size * sizeof(char*) +
+        database_packed_scene->instances_size * (sizeof(char*) + sizeof(struct DATABASE_PACKED_INSTANCE_STRUCT))
+    );
+
+    free(database_packed_scene->actor_definition_ids);
+    free(database_packed_scene->ids);
+    free(database_packed_scene->instances);
+    free(database_packed_scene);
+}
+
+char* database_packed_create_sql(const char* schema)
+{
+    char* sql_template =
+        "CREATE TABLE IF NOT EXISTS %s.packed_scenes(scene_id TEXT PRIMARY KEY, version INT, actor_definition_ids BLOB, ids BLOB, instances BLOB);"
+        "CREATE TRIGGER IF NOT EXISTS %s.actor_instances_packed_insert AFTER INSERT ON actor_instances BEGIN "
+        "DELETE FROM packed_scenes WHERE scene_id = new.scene_id; END;"
+        "CREATE TRIGGER IF NOT EXISTS %s.actor_instances_packed_update AFTER UPDATE ON actor_instances BEGIN "
+        "DELETE FROM packed_scenes WHERE scene_id IN (old.scene_id, new.scene_id); END;"
+        "CREATE TRIGGER IF NOT EXISTS %s.actor_instances_packed_delete AFTER DELETE ON actor_instances BEGIN "
+        "DELETE FROM packed_scenes WHERE scene_id = old.scene_id; END;";
+
+    char* sql = calloc(strlen(sql_template) + strlen(schema) * 4 + 1, sizeof(char));
+    sprintf(sql, sql_template, schema, schema, schema, schema);
+
+    return sql;
+}
+
+/**
+ * Growable byte buffer the blobs are built in.
+ */
+typedef struct DATABASE_PACKED_BUFFER_STRUCT
+{
+    char* data;
+    size_t size;
+    size_t capacity;
+} database_packed_buffer_T;
+
+static void database_packed_buffer_append(database_packed_buffer_T* buffer, const void* data, size_t size)
+{
+    if (buffer->size + size > buffer->capacity)
+    {
+        buffer->capacity = (buffer->size + size) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static int database_packed_compare_ids(const void* a, const void* b)
+{
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+typedef struct DATABASE_SCENE_PACK_STRUCT
+{
+    database_T* database;
+    const char* scene_id;
+} database_scene_pack_T;
+
+static int database_run_scene_pack(sqlite3* db, void* user_data)
+{
+    database_scene_pack_T* pack = (database_scene_pack_T*) user_data;
+    database_T* database = pack->database;
+    unsigned int sharded = database->flags & DATABASE_SHARD_SCENES;
+
+    // a scene without a shard has no instances, it simply loads empty from rows
+    if (sharded && !database_attach_scene(database, db, pack->scene_id, 0))
+        return SQLITE_OK;
+
+    char* schema = database_get_scene_schema(database, pack->scene_id);
+    char* sql = calloc(strlen(schema) + 256, sizeof(char));
+    sqlite3_stmt* stmt;
+
+    sqlite3_exec(db, "BEGIN", 0, 0, 0);
+
+    // packs are dropped whenever the instances change, one still there is
+    // current; a queued pack may also run after its scene was deleted
+    sprintf(
+        sql,
+        "SELECT NOT EXISTS(SELECT 1 FROM main.scenes WHERE id=?1)"
+        " OR EXISTS(SELECT 1 FROM %s.packed_scenes WHERE scene_id=?1 AND version=%d)",
+        schema, DATABASE_PACKED_VERSION
+    );
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, pack->scene_id, -1, SQLITE_STATIC);
+        unsigned int skip = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+
+        if (skip)
+        {
+            sqlite3_exec(db, "COMMIT", 0, 0, 0);
+            free(sql);
+            free(schema);
+
+            if (sharded)
+                database_detach_scene(database, db, pack->scene_id);
+
+            return SQLITE_OK;
+        }
+    }
+
+    // the definition index table, sorted so instances find their index by bisection
+    sprintf(sql, "SELECT DISTINCT actor_definition_id FROM %s.actor_instances WHERE scene_id=? ORDER BY actor_definition_id", schema);
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+
+    char** actor_definition_ids = (void*) 0;
+    size_t actor_definition_ids_size = 0;
+    database_packed_buffer_T definitions_blob = { 0 };
+
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, pack->scene_id, -1, SQLITE_STATIC);
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const char* id = (const char*) sqlite3_column_text(stmt, 0);
+
+            if (id == (void*) 0)
+                id = "";
+
+            actor_definition_ids = realloc(actor_definition_ids, (actor_definition_ids_size + 1) * sizeof(char*));
+            actor_definition_ids[actor_definition_ids_size] = calloc(strlen(id) + 1, sizeof(char));
+            strcpy(actor_definition_ids[actor_definition_ids_size++], id);
+
+            database_packed_buffer_append(&definitions_blob, id, strlen(id) + 1);
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    database_packed_buffer_T ids_blob = { 0 };
+    database_packed_buffer_T instances_blob = { 0 };
+
+    if (rc == SQLITE_OK)
+    {
+        sprintf(sql, "SELECT id, actor_definition_id, x, y, z, rx, ry, rz FROM %s.actor_instances WHERE scene_id=?", schema);
+        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, pack->scene_id, -1, SQLITE_STATIC);
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const char* id = (const char*) sqlite3_column_text(stmt, 0);
+            const char* actor_definition_id = (const char*) sqlite3_column_text(stmt, 1);
+
+            if (id == (void*) 0)
+                id = "";
+
+            if (actor_definition_id == (void*) 0)
+                actor_definition_id = "";
+
+            char** found = bsearch(
+                &actor_definition_id,
+                actor_definition_ids,
+                actor_definition_ids_size,
+                sizeof(char*),
+                database_packed_compare_ids
+            );
+
+            database_packed_instance_T instance;
+            instance.definition = found - actor_definition_ids;
+            instance.x = sqlite3_column_double(stmt, 2);
+            instance.y = sqlite3_column_double(stmt, 3);
+            instance.z = sqlite3_column_double(stmt, 4);
+            instance.rx = sqlite3_column_double(stmt, 5);
+            instance.ry = sqlite3_column_double(stmt, 6);
+            instance.rz = sqlite3_column_double(stmt, 7);
+
+            database_packed_buffer_append(&ids_blob, id, strlen(id) + 1);
+            database_packed_buffer_append(&instances_blob, &instance, sizeof(instance));
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (rc == SQLITE_OK)
+    {
+        sprintf(sql, "INSERT OR REPLACE INTO %s.packed_scenes VALUES(?, ?, ?, ?, ?)", schema);
+        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, pack->scene_id, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, DATABASE_PACKED_VERSION);
+        sqlite3_bind_blob(stmt, 3, definitions_blob.data, definitions_blob.size, SQLITE_STATIC);
+        sqlite3_bind_blob(stmt, 4, ids_blob.data, ids_blob.size, SQLITE_STATIC);
+        sqlite3_bind_blob(stmt, 5, instances_blob.data, instances_blob.size, SQLITE_STATIC);
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_finalize(stmt);
+    }
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "COMMIT", 0, 0, 0);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR packing scene %s: %s\n", pack->scene_id, sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+    }
+
+    for (size_t i = 0; i < actor_definition_ids_size; i++)
+        free(actor_definition_ids[i]);
+
+    free(actor_definition_ids);
+    free(definitions_blob.data);
+    free(ids_blob.data);
+    free(instances_blob.data);
+    free(sql);
+    free(schema);
+
+    if (sharded)
+        database_detach_scene(database, db, pack->scene_id);
+
+    return rc;
+}
+
+int database_pack_scene(database_T* database, const char* scene_id)
+{
+    database_scene_pack_T pack;
+    pack.database = database;
+    pack.scene_id = scene_id;
+
+    return database_submit_write(database, database_run_scene_pack, &pack);
+}
+
+static int database_run_queued_scene_pack(sqlite3* db, void* user_data)
+{
+    int rc = database_run_scene_pack(db, user_data);
+    free(user_data);
+
+    return rc;
+}
+
+void database_queue_scene_pack(database_T* database, const char* scene_id)
+{
+    if (database->database_writer == (void*) 0)
+        return;
+
+    database_scene_pack_T* pack = calloc(1, sizeof(struct DATABASE_SCENE_PACK_STRUCT));
+    pack->database = database;
+
+    // interned, it outlives the pack however late the writer gets to it
+    pack->scene_id = database_intern(database, scene_id);
+
+    database_writer_post(database->database_writer, database_run_queued_scene_pack, pack);
+}
+
+/**
+ * Interns the NUL separated strings of a blob, count of them.
+ */
+static char** database_packed_read_strings(intern_table_T* intern_table, const char* blob, int bytes, size_t count)
+{
+    char** strings = calloc(count + 1, sizeof(char*));
+    int offset = 0;
+
+    for (size_t i = 0; i < count && offset < bytes; i++)
+    {
+        size_t length = strnlen(blob + offset, bytes - offset);
+        strings[i] = intern_table_intern_n(intern_table, blob + offset, length);
+        offset += length + 1;
+    }
+
+    return strings;
+}
+
+static size_t database_packed_count_strings(const char* blob, int bytes)
+{
+    size_t count = 0;
+
+    for (int i = 0; i < bytes; i++)
+    {
+        if (blob[i] == '\0')
+            count++;
+    }
+
+    return count;
+}
+
+database_packed_scene_T* database_load_packed_scene(database_T* database, const char* scene_id)
+{
+    char* schema = database_get_scene_schema(database, scene_id);
+    char* sql = calloc(strlen(schema) + 128, sizeof(char));
+    sprintf(sql, "SELECT version, actor_definition_ids, ids, instances FROM %s.packed_scenes WHERE scene_id=?", schema);
+    free(schema);
+
+    sqlite3_stmt* stmt = database_exec_scene_sql(database, scene_id, sql, 0);
+    free(sql);
+
+    if (stmt == (void*) 0)
+        return (void*) 0;
+
+    sqlite3_bind_text(stmt, 1, scene_id, -1, SQLITE_TRANSIENT);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW || sqlite3_column_int(stmt, 0) != DATABASE_PACKED_VERSION)
+    {
+        database_finalize_scene(database, scene_id, stmt);
+        return (void*) 0;
+    }
+
+    database_packed_scene_T* database_packed_scene = calloc(1, sizeof(struct DATABASE_PACKED_SCENE_STRUCT));
+    database_packed_scene->scene_id = intern_table_intern(database->intern_table, scene_id);
+
+    const char* definitions_blob = sqlite3_column_blob(stmt, 1);
+    int definitions_bytes = sqlite3_column_bytes(stmt, 1);
+    database_packed_scene->actor_definition_ids_size = database_packed_count_strings(definitions_blob, definitions_bytes);
+    database_packed_scene->actor_definition_ids = database_packed_read_strings(
+        database->intern_table,
+        definitions_blob,
+        definitions_bytes,
+        database_packed_scene->actor_definition_ids_size
+    );
+
+    const void* instances_blob = sqlite3_column_blob(stmt, 3);
+    int instances_bytes = sqlite3_column_bytes(stmt, 3);
+    database_packed_scene->instances_size = instances_bytes / sizeof(struct DATABASE_PACKED_INSTANCE_STRUCT);
+    database_packed_scene->instances = malloc(instances_bytes + 1);
+
+    if (instances_bytes > 0)
+        memcpy(database_packed_scene->instances, instances_blob, instances_bytes);
+
+    database_packed_scene->ids = database_packed_read_strings(
+        database->intern_table,
+        sqlite3_column_blob(stmt, 2),
+        sqlite3_column_bytes(stmt, 2),
+        database_packed_scene->instances_size
+    );
+
+    database_finalize_scene(database, scene_id, stmt);
+
+    database_memory_track_alloc(
+        DATABASE_MEMORY_ENTITIES,
+        database_packed_scene->actor_definition_ids_size * sizeof(char*) +
+        database_packed_scene->instances_size * (sizeof(char*) + sizeof(struct DATABASE_PACKED_INSTANCE_STRUCT))
+    );
+
+    return database_packed_scene;
+}
+
+dynamic_list_T* database_packed_scene_get_actor_instances(database_T* database, database_packed_scene_T* database_packed_scene)
+{
+    dynamic_list_T* database_actor_instances = init_dynamic_list(sizeof(struct DATABASE_ACTOR_INSTANCE_STRUCT*));
+    size_t definitions_size = database_packed_scene->actor_definition_ids_size;
+
+    // every definition is looked up once, each further instance just takes a reference
+    database_actor_definition_T** definitions = calloc(definitions_size + 1, sizeof(database_actor_definition_T*));
+    unsigned int* used = calloc(definitions_size + 1, sizeof(unsigned int));
+
+    for (size_t i = 0; i < definitions_size; i++)
+        definitions[i] = database_get_actor_definition_by_id(database, database_packed_scene->actor_definition_ids[i]);
+
+    for (size_t i = 0; i < database_packed_scene->instances_size; i++)
+    {
+        database_packed_instance_T* instance = &database_packed_scene->instances[i];
+        uint32_t definition = instance->definition < definitions_size ? instance->definition : 0;
+        database_actor_definition_T* database_actor_definition = definitions_size > 0 ? definitions[definition] : (void*) 0;
+
+        if (database_actor_definition != (void*) 0 && used[definition]++ > 0)
+            database_actor_definition->references += 1;
+
+        database_actor_instance_T* database_actor_instance = init_database_actor_instance(
+            database_packed_scene->ids[i],
+            definitions_size > 0 ? database_packed_scene->actor_definition_ids[definition] : (void*) 0,
+            database_packed_scene->scene_id,
+            instance->x,
+            instance->y,
+            instance->z,
+            database_actor_definition
+        );
+        database_actor_instance->rx = instance->rx;
+        database_actor_instance->ry = instance->ry;
+        database_actor_instance->rz = instance->rz;
+
+        dynamic_list_append(database_actor_instances, database_actor_instance);
+    }
+
+    // a definition no instance ended up using gives its reference back
+    for (size_t i = 0; i < definitions_size; i++)
+    {
+        if (definitions[i] != (void*) 0 && used[i] == 0)
+            database_actor_definition_free(definitions[i]);
+    }
+
+    free(used);
+    free(definitions);
+
+    return database_actor_instances;
+}
@@ -0,0 +1,203 @@
+#include "include/database_pagination.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+/**
+ * Rows are selected as "rowid, <columns>", so every mapper reads the table
+ * columns shifted by one.
+ */
+static void* database_scene_from_row(database_T* database, sqlite3_stmt* stmt)
+{
+    database_scene_T* database_scene = init_database_scene((void*) 0, (void*) 0, 0);
+    database_table_read(stmt, &database_scenes_table, database->intern_table, 1, database_scene);
+
+    return database_scene;
+}
+
+static void* database_sprite_from_row(database_T* database, sqlite3_stmt* stmt)
+{
+    database_sprite_T* database_sprite = init_database_sprite((void*) 0, (void*) 0, (void*) 0, (void*) 0);
+    database_table_read(stmt, &database_sprites_table, database->intern_table, 1, database_sprite);
+
+    return database_sprite;
+}
+
+static void* database_script_from_row(database_T* database, sqlite3_stmt* stmt)
+{
+    database_script_T* database_script = init_database_script((void*) 0, (void*) 0, (void*) 0, (void*) 0);
+    database_table_read(stmt, &database_scripts_table, database->intern_table, 1, database_script);
+
+    return database_script;
+}
+
+static void* database_actor_definition_from_row(database_T* database, sqlite3_stmt* stmt)
+{
+    database_actor_definition_T* database_actor_definition = init_database_actor_definition(
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0,
+        (void*) 0
+    );
+    database_table_read(stmt, &database_actor_definitions_table, database->intern_table, 1, database_actor_definition);
+
+    return database_actor_definition;
+}
+
+static dynamic_list_T* database_get_page(
+    database_T* database,
+    const database_table_T* table,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token,
+    void* (*map_row)(database_T* database, sqlite3_stmt* stmt),
+    size_t item_size
+)
+{
+    dynamic_list_T* page = init_dynamic_list(item_size);
+    *next_token = (void*) 0;
+
+    long long after_rowid = 0;
+    const char* after_name = (void*) 0;
+
+    if (continuation_token != (void*) 0)
+    {
+        after_rowid = strtoll(continuation_token, (void*) 0, 10);
+        after_name = strchr(continuation_token, ':');
+
+        if (after_name == (void*) 0)
+        {
+            printf("ERROR invalid continuation token: %s\n", continuation_token);
+            return page;
+        }
+
+        after_name += 1;
+    }
+
+    // a NULL name sorts as the empty one, or the row comparison would drop
+    // every row after it; spelled out so the <table>_page index is searched
+    char* sql = database_table_select_sql(
+        table,
+        (void*) 0,
+        "rowid",
+        after_name == (void*) 0 ?
+            "ORDER BY COALESCE(name, ''), rowid LIMIT ?3" :
+            "WHERE COALESCE(name, '') >= ?1 AND (COALESCE(name, '') > ?1 OR rowid > ?2)"
+            " ORDER BY COALESCE(name, ''), rowid LIMIT ?3"
+    );
+
+    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    free(sql);
+
+    if (stmt == (void*) 0)
+        return page;
+
+    if (after_name != (void*) 0)
+    {
+        sqlite3_bind_text(stmt, 1, after_name, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, after_rowid);
+    }
+
+    sqlite3_bind_int64(stmt, 3, (sqlite3_int64) page_size + 1);
+
+    while (page->size < page_size && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        dynamic_list_append(page, map_row(database, stmt));
+
+        if (page->size == page_size)
+        {
+            const char* name = (const char*) sqlite3_column_text(stmt, 2);
+            size_t name_len = name == (void*) 0 ? 0 : strlen(name);
+
+            *next_token = calloc(32 + name_len, sizeof(char));
+            sprintf(*next_token, "%lld:%s", sqlite3_column_int64(stmt, 0), name == (void*) 0 ? "" : name);
+        }
+    }
+
+    // the extra row we asked for tells us whether there is another page
+    if (*next_token != (void*) 0 && sqlite3_step(stmt) != SQLITE_ROW)
+    {
+        free(*next_token);
+        *next_token = (void*) 0;
+    }
+
+    database_finalize(database, stmt);
+
+    return page;
+}
+
+dynamic_list_T* database_get_scenes_page(
+    database_T* database,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token
+)
+{
+    return database_get_page(
+        database,
+        &database_scenes_table,
+        continuation_token,
+        page_size,
+        next_token,
+        database_scene_from_row,
+        sizeof(struct DATABASE_SCENE_STRUCT*)
+    );
+}
+
+dynamic_list_T* database_get_sprites_page(
+    database_T* database,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token
+)
+{
+    return database_get_page(
+        database,
+        &database_sprites_table,
+        continuation_token,
+        page_size,
+        next_token,
+        database_sprite_from_row,
+        sizeof(struct DATABASE_SPRITE_STRUCT*)
+    );
+}
+
+dynamic_list_T* database_get_scripts_page(
+    database_T* database,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token
+)
+{
+    return database_get_page(
+        database,
+        &database_scripts_table,
+        continuation_token,
+        page_size,
+        next_token,
+        database_script_from_row,
+        sizeof(struct DATABASE_SCRIPT_STRUCT*)
+    );
+}
+
+dynamic_list_T* database_get_actor_definitions_page(
+    database_T* database,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token
+)
+{
+    return database_get_page(
+        database,
+        &database_actor_definitions_table,
+        continuation_token,
+        page_size,
+        next_token,
+        database_actor_definition_from_row,
+        sizeof(struct DATABASE_ACTOR_DEFINITION_STRUCT*)
+    );
+}
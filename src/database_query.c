@@ -0,0 +1,185 @@
+#include "include/database_query.h"
+#include "include/database_schema.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DATABASE_QUERY_PROGRESS_OPS 1000
+
+
+static long long database_query_now_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long) now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+/**
+ * Interrupts the step once the query is cancelled or its budget is spent,
+ * so a step scanning without returning rows does not run over either.
+ */
+static int database_query_progress(void* user_data)
+{
+    database_query_T* database_query = (database_query_T*) user_data;
+
+    return atomic_load(&database_query->cancelled) || database_query_now_us() >= database_query->deadline;
+}
+
+static unsigned int database_query_owned(database_query_T* database_query, const char* function)
+{
+    if (pthread_equal(database_query->owner, pthread_self()))
+        return 1;
+
+    printf("ERROR %s: the query belongs to the thread that began it\n", function);
+
+    return 0;
+}
+
+database_query_T* database_begin_get_all_actor_instances_by_scene_id(database_T* database, const char* scene_id)
+{
+    database_query_T* database_query = calloc(1, sizeof(struct DATABASE_QUERY_STRUCT));
+    database_query->database = database;
+    database_query->results = init_dynamic_list(sizeof(struct DATABASE_ACTOR_INSTANCE_STRUCT*));
+    database_query->scene_id = calloc(strlen(scene_id) + 1, sizeof(char));
+    strcpy(database_query->scene_id, scene_id);
+    database_query->owner = pthread_self();
+    database_query->last_rowid = INT64_MIN;
+    atomic_init(&database_query->cancelled, 0);
+    atomic_init(&database_query->stepping, 0);
+
+    database_query->status = DATABASE_QUERY_DONE;
+
+    // its own connection, so the open statement pins no snapshot and the
+    // progress handler and interrupt touch no other reads
+    database_query->db = database_open_reader(database);
+
+    if (database_query->db == (void*) 0)
+    {
+        database_query->status = DATABASE_QUERY_ERROR;
+        return database_query;
+    }
+
+    // a scene that has no shard yet has nothing to stream
+    if ((database->flags & DATABASE_SHARD_SCENES) && !database_attach_scene(database, database_query->db, scene_id, 0))
+        return database_query;
+
+    char* schema = database_get_scene_schema(database, scene_id);
+    // in rowid order, so a step interrupted by its budget resumes past the last row read
+    char* sql = database_table_select_sql(
+        &database_actor_instances_table,
+        schema,
+        "rowid",
+        "WHERE scene_id=?1 AND rowid > ?2 ORDER BY rowid"
+    );
+    free(schema);
+
+    if (sqlite3_prepare_v2(database_query->db, sql, -1, &database_query->stmt, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_text(database_query->stmt, 1, database_query->scene_id, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(database_query->stmt, 2, database_query->last_rowid);
+        database_query->status = DATABASE_QUERY_PENDING;
+    }
+    else
+    {
+        printf("ERROR preparing query: %s\n", sqlite3_errmsg(database_query->db));
+        database_query->status = DATABASE_QUERY_ERROR;
+    }
+
+    free(sql);
+
+    return database_query;
+}
+
+static void database_query_finish(database_query_T* database_query, int status)
+{
+    sqlite3_finalize(database_query->stmt);
+    database_query->stmt = (void*) 0;
+    database_query->status = status;
+}
+
+int database_query_step(database_query_T* database_query, unsigned int budget_us)
+{
+    if (database_query->status != DATABASE_QUERY_PENDING)
+        return database_query->status;
+
+    sqlite3* db = database_query->db;
+    database_query->deadline = database_query_now_us() + budget_us;
+
+    sqlite3_progress_handler(db, DATABASE_QUERY_PROGRESS_OPS, database_query_progress, database_query);
+    atomic_store(&database_query->stepping, 1);
+
+    while (!atomic_load(&database_query->cancelled))
+    {
+        int rc = sqlite3_step(database_query->stmt);
+
+        if (rc == SQLITE_DONE)
+        {
+            database_query_finish(database_query, DATABASE_QUERY_DONE);
+            break;
+        }
+
+        // out of time, the next step starts the statement over past the last row
+        if (rc == SQLITE_INTERRUPT && !atomic_load(&database_query->cancelled))
+        {
+            sqlite3_reset(database_query->stmt);
+            sqlite3_bind_int64(database_query->stmt, 2, database_query->last_rowid);
+            break;
+        }
+
+        if (rc != SQLITE_ROW)
+        {
+            if (rc != SQLITE_INTERRUPT)
+                printf("ERROR executing query: %s\n", sqlite3_errmsg(db));
+
+            database_query_finish(database_query, rc == SQLITE_INTERRUPT ? DATABASE_QUERY_CANCELLED : DATABASE_QUERY_ERROR);
+            break;
+        }
+
+        database_query->last_rowid = sqlite3_column_int64(database_query->stmt, 0);
+
+        dynamic_list_append(
+            database_query->results,
+            database_actor_instance_from_row(database_query->database, database_query->stmt, 1)
+        );
+
+        if (database_query_now_us() >= database_query->deadline)
+            break;
+    }
+
+    atomic_store(&database_query->stepping, 0);
+    sqlite3_progress_handler(db, 0, (void*) 0, (void*) 0);
+
+    if (database_query->status == DATABASE_QUERY_PENDING && atomic_load(&database_query->cancelled))
+        database_query_finish(database_query, DATABASE_QUERY_CANCELLED);
+
+    return database_query->status;
+}
+
+void database_query_cancel(database_query_T* database_query)
+{
+    if (!database_query_owned(database_query, "cancelling query"))
+        return;
+
+    atomic_store(&database_query->cancelled, 1);
+
+    // wake a step that is blocked inside sqlite, the progress handler only
+    // runs while the virtual machine is executing
+    if (atomic_load(&database_query->stepping))
+        sqlite3_interrupt(database_query->db);
+}
+
+void database_query_free(database_query_T* database_query)
+{
+    // leaked rather than closed under a cancel still running elsewhere
+    if (!database_query_owned(database_query, "freeing query"))
+        return;
+
+    sqlite3_finalize(database_query->stmt);
+    sqlite3_close(database_query->db);
+
+    free(database_query->results->items);
+    free(database_query->results);
+    free(database_query->scene_id);
+    free(database_query);
+}
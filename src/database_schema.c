@@ -0,0 +1,329 @@
+#include "include/database_schema.h"
+#include "include/database.h"
+#include "include/database_memory.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+#define DATABASE_TABLE_DEFINE(table_name, row_type, COLUMNS) \
+    static const database_column_T table_name##_columns[] = { COLUMNS(DATABASE_COLUMN_DESCRIPTOR, row_type) }; \
+    const database_table_T database_##table_name##_table = { \
+        #table_name, \
+        table_name##_columns, \
+        sizeof(table_name##_columns) / sizeof(database_column_T) \
+    };
+
+DATABASE_TABLE_DEFINE(sprites, database_sprite_T, DATABASE_SPRITES_COLUMNS)
+DATABASE_TABLE_DEFINE(actor_definitions, database_actor_definition_T, DATABASE_ACTOR_DEFINITIONS_COLUMNS)
+DATABASE_TABLE_DEFINE(scenes, database_scene_T, DATABASE_SCENES_COLUMNS)
+DATABASE_TABLE_DEFINE(actor_instances, database_actor_instance_T, DATABASE_ACTOR_INSTANCES_COLUMNS)
+DATABASE_TABLE_DEFINE(scripts, database_script_T, DATABASE_SCRIPTS_COLUMNS)
+
+static char* database_table_qualified_name(const database_table_T* table, const char* schema)
+{
+    char* name = calloc((schema == (void*) 0 ? 0 : strlen(schema) + 1) + strlen(table->name) + 1, sizeof(char));
+
+    if (schema != (void*) 0)
+        sprintf(name, "%s.%s", schema, table->name);
+    else
+        strcpy(name, table->name);
+
+    return name;
+}
+
+#define DATABASE_TABLE_NAMES 0
+#define DATABASE_TABLE_DEFINITIONS 1
+#define DATABASE_TABLE_PARAMETERS 2
+#define DATABASE_TABLE_ASSIGNMENTS 3
+
+/**
+ * Comma separated list of the columns from first on, as names, as
+ * "name type" definitions, as ?<i + 1> parameters or as name=?<i + 1>.
+ */
+static char* database_table_join(const database_table_T* table, int list, size_t first)
+{
+    size_t size = 1;
+
+    for (size_t i = first; i < table->columns_size; i++)
+        size += strlen(table->columns[i].name) + strlen(table->columns[i].sql_type) + 32;
+
+    char* joined = calloc(size, sizeof(char));
+    char* end = joined;
+
+    for (size_t i = first; i < table->columns_size; i++)
+    {
+        const database_column_T* column = &table->columns[i];
+
+        if (i > first)
+            end += sprintf(end, ", ");
+
+        if (list == DATABASE_TABLE_NAMES)
+            end += sprintf(end, "%s", column->name);
+        else if (list == DATABASE_TABLE_DEFINITIONS)
+            end += sprintf(end, "%s %s", column->name, column->sql_type);
+        else if (list == DATABASE_TABLE_PARAMETERS)
+            end += sprintf(end, "?%zu", i + 1);
+        else
+            end += sprintf(end, "%s=?%zu", column->name, i + 1);
+    }
+
+    return joined;
+}
+
+char* database_table_create_sql(const database_table_T* table, const char* schema)
+{
+    char* name = database_table_qualified_name(table, schema);
+    char* columns = database_table_join(table, DATABASE_TABLE_DEFINITIONS, 0);
+
+    char* sql = calloc(strlen("CREATE TABLE IF NOT EXISTS ()") + strlen(name) + strlen(columns) + 1, sizeof(char));
+    sprintf(sql, "CREATE TABLE IF NOT EXISTS %s(%s)", name, columns);
+
+    free(name);
+    free(columns);
+
+    return sql;
+}
+
+int database_table_migrate(sqlite3* db, const database_table_T* table, const char* schema, char** err_msg)
+{
+    if (schema == (void*) 0)
+        schema = "main";
+
+    char* pragma_sql = calloc(strlen("PRAGMA .table_info()") + strlen(schema) + strlen(table->name) + 1, sizeof(char));
+    sprintf(pragma_sql, "PRAGMA %s.table_info(%s)", schema, table->name);
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, pragma_sql, -1, &stmt, NULL);
+    free(pragma_sql);
+
+    if (rc != SQLITE_OK)
+    {
+        *err_msg = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+        return rc;
+    }
+
+    unsigned int* found = calloc(table->columns_size, sizeof(unsigned int));
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* name = (const char*) sqlite3_column_text(stmt, 1);
+
+        for (size_t i = 0; i < table->columns_size; i++)
+        {
+            if (strcmp(table->columns[i].name, name) == 0)
+                found[i] = 1;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    char* name = database_table_qualified_name(table, schema);
+
+    for (size_t i = 0; i < table->columns_size && rc == SQLITE_OK; i++)
+    {
+        if (found[i])
+            continue;
+
+        const database_column_T* column = &table->columns[i];
+        char* sql = calloc(
+            strlen("ALTER TABLE  ADD COLUMN  ") + strlen(name) + strlen(column->name) + strlen(column->sql_type) + 1,
+            sizeof(char)
+        );
+        sprintf(sql, "ALTER TABLE %s ADD COLUMN %s %s", name, column->name, column->sql_type);
+        rc = sqlite3_exec(db, sql, 0, 0, err_msg);
+        free(sql);
+    }
+
+    free(name);
+    free(found);
+
+    return rc;
+}
+
+char* database_table_select_sql(const database_table_T* table, const char* schema, const char* prefix, const char* clause)
+{
+    char* name = database_table_qualified_name(table, schema);
+    char* columns = database_table_join(table, DATABASE_TABLE_NAMES, 0);
+
+    if (prefix == (void*) 0)
+        prefix = "";
+
+    if (clause == (void*) 0)
+        clause = "";
+
+    char* sql = calloc(
+        strlen("SELECT ,  FROM  ") + strlen(prefix) + strlen(columns) + strlen(name) + strlen(clause) + 1,
+        sizeof(char)
+    );
+    sprintf(sql, "SELECT %s%s%s FROM %s %s", prefix, strlen(prefix) ? ", " : "", columns, name, clause);
+
+    free(name);
+    free(columns);
+
+    return sql;
+}
+
+char* database_table_insert_sql(const database_table_T* table, const char* schema)
+{
+    char* name = database_table_qualified_name(table, schema);
+    char* columns = database_table_join(table, DATABASE_TABLE_NAMES, 0);
+    char* parameters = database_table_join(table, DATABASE_TABLE_PARAMETERS, 0);
+
+    char* sql = calloc(
+        strlen("INSERT INTO () VALUES()") + strlen(name) + strlen(columns) + strlen(parameters) + 1,
+        sizeof(char)
+    );
+    sprintf(sql, "INSERT INTO %s(%s) VALUES(%s)", name, columns, parameters);
+
+    free(name);
+    free(columns);
+    free(parameters);
+
+    return sql;
+}
+
+char* database_table_copy_sql(
+    const database_table_T* table,
+    const char* schema,
+    const char* from_schema,
+    const char** replacements,
+    const char* clause
+)
+{
+    char* name = database_table_qualified_name(table, schema);
+    char* from_name = database_table_qualified_name(table, from_schema);
+    char* columns = database_table_join(table, DATABASE_TABLE_NAMES, 0);
+    size_t size = 1;
+
+    for (size_t i = 0; i < table->columns_size; i++)
+        size += strlen(replacements[i] != (void*) 0 ? replacements[i] : table->columns[i].name) + 2;
+
+    char* selected = calloc(size, sizeof(char));
+
+    for (size_t i = 0; i < table->columns_size; i++)
+    {
+        if (i > 0)
+            strcat(selected, ", ");
+
+        strcat(selected, replacements[i] != (void*) 0 ? replacements[i] : table->columns[i].name);
+    }
+
+    if (clause == (void*) 0)
+        clause = "";
+
+    char* sql = calloc(
+        strlen("INSERT INTO () SELECT  FROM  ") + strlen(name) + strlen(columns) + strlen(selected) + strlen(from_name) + strlen(clause) + 1,
+        sizeof(char)
+    );
+    sprintf(sql, "INSERT INTO %s(%s) SELECT %s FROM %s %s", name, columns, selected, from_name, clause);
+
+    free(name);
+    free(from_name);
+    free(columns);
+    free(selected);
+
+    return sql;
+}
+
+char* database_table_update_sql(const database_table_T* table, const char* schema)
+{
+    char* name = database_table_qualified_name(table, schema);
+    char* assignments = database_table_join(table, DATABASE_TABLE_ASSIGNMENTS, 1);
+
+    char* sql = calloc(strlen("UPDATE  SET  WHERE id=?1") + strlen(name) + strlen(assignments) + 1, sizeof(char));
+    sprintf(sql, "UPDATE %s SET %s WHERE id=?1", name, assignments);
+
+    free(name);
+    free(assignments);
+
+    return sql;
+}
+
+void database_table_bind(sqlite3_stmt* stmt, const database_table_T* table, const void* row)
+{
+    for (size_t i = 0; i < table->columns_size; i++)
+    {
+        const database_column_T* column = &table->columns[i];
+        const char* field = (const char*) row + column->offset;
+        int parameter = i + 1;
+
+        if (column->kind == DATABASE_COLUMN_INT)
+        {
+            sqlite3_bind_int(stmt, parameter, *(const int*) field);
+            continue;
+        }
+
+        if (column->kind == DATABASE_COLUMN_FLOAT)
+        {
+            sqlite3_bind_double(stmt, parameter, *(const float*) field);
+            continue;
+        }
+
+        const char* text = *(char* const*) field;
+
+        // missing optional references have always been stored as ''
+        if (text == (void*) 0 && column->kind == DATABASE_COLUMN_OPTIONAL_TEXT)
+            text = "";
+
+        if (text == (void*) 0)
+            sqlite3_bind_null(stmt, parameter);
+        else
+            sqlite3_bind_text(stmt, parameter, text, -1, SQLITE_TRANSIENT);
+    }
+}
+
+void database_table_read(
+    sqlite3_stmt* stmt,
+    const database_table_T* table,
+    intern_table_T* intern_table,
+    int first_column,
+    void* row
+)
+{
+    for (size_t i = 0; i < table->columns_size; i++)
+    {
+        const database_column_T* column = &table->columns[i];
+        char* field = (char*) row + column->offset;
+        int index = first_column + i;
+
+        if (column->kind == DATABASE_COLUMN_INT)
+        {
+            *(int*) field = sqlite3_column_int(stmt, index);
+            continue;
+        }
+
+        if (column->kind == DATABASE_COLUMN_FLOAT)
+        {
+            *(float*) field = sqlite3_column_double(stmt, index);
+            continue;
+        }
+
+        const char* text = (const char*) sqlite3_column_text(stmt, index);
+        int bytes = sqlite3_column_bytes(stmt, index);
+        char* value = (void*) 0;
+
+        if (text != (void*) 0 && !(column->kind == DATABASE_COLUMN_OPTIONAL_TEXT && bytes == 0))
+        {
+            if (column->kind == DATABASE_COLUMN_PATH)
+            {
+                value = calloc(bytes + 1, sizeof(char));
+                memcpy(value, text, bytes);
+                database_memory_track_alloc(DATABASE_MEMORY_STRINGS, bytes + 1);
+            }
+            else
+            {
+                value = intern_table_intern_n(intern_table, text, bytes);
+            }
+        }
+
+        // the row owns its path, reading into it again gives the old one back
+        if (column->kind == DATABASE_COLUMN_PATH && *(char**) field != (void*) 0)
+        {
+            database_memory_track_free(DATABASE_MEMORY_STRINGS, strlen(*(char**) field) + 1);
+            free(*(char**) field);
+        }
+
+        *(char**) field = value;
+    }
+}
@@ -0,0 +1,421 @@
+#include "include/database_search.h"
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/**
+ * Indexed tables, assets of table i are of kind 1 << i.
+ */
+#define DATABASE_SEARCH_KINDS 4
+
+/**
+ * Trigrams found in more names than this say little about a name and
+ * make the fuzzy pass rank most of the index, they are left out of it.
+ */
+#define DATABASE_SEARCH_FUZZY_MAX_NAMES 2000
+
+
+static const char* database_search_tables[DATABASE_SEARCH_KINDS] = {
+    "sprites",
+    "scripts",
+    "actor_definitions",
+    "scenes"
+};
+
+database_asset_T* init_database_asset(int kind, char* id, char* name)
+{
+    database_asset_T* database_asset = calloc(1, sizeof(struct DATABASE_ASSET_STRUCT));
+    database_asset->kind = kind;
+    database_asset->id = id;
+    database_asset->name = name;
+
+    return database_asset;
+}
+
+void database_asset_free(database_asset_T* database_asset)
+{
+    free(database_asset);
+}
+
+/**
+ * Drops the triggers of every indexed table, writes to them must not fail
+ * because the index cannot be kept up to date.
+ */
+static void database_search_drop_triggers(sqlite3* db)
+{
+    for (int i = 0; i < DATABASE_SEARCH_KINDS; i++)
+    {
+        const char* table = database_search_tables[i];
+        char sql[512];
+
+        sprintf(
+            sql,
+            "DROP TRIGGER IF EXISTS %s_names_insert;"
+            "DROP TRIGGER IF EXISTS %s_names_update;"
+            "DROP TRIGGER IF EXISTS %s_names_delete;",
+            table, table, table
+        );
+
+        sqlite3_exec(db, sql, 0, 0, 0);
+    }
+}
+
+/**
+ * Whether the index has to be rebuilt: it was never built, was built by a
+ * version keying it on source rowids, or some of its triggers are gone.
+ */
+static unsigned int database_search_stale(sqlite3* db)
+{
+    sqlite3_stmt* stmt;
+    unsigned int stale = 1;
+
+    if (sqlite3_prepare_v2(
+        db,
+        "SELECT count(*) FROM sqlite_master WHERE (type='table' AND name IN ('asset_names', 'asset_name_keys'))"
+        " OR (type='trigger' AND name LIKE '%\\_names\\_%' ESCAPE '\\')",
+        -1, &stmt, NULL
+    ) == SQLITE_OK)
+    {
+        // both tables and the three triggers of every indexed table
+        stale = sqlite3_step(stmt) != SQLITE_ROW || sqlite3_column_int(stmt, 0) != 2 + 3 * DATABASE_SEARCH_KINDS;
+        sqlite3_finalize(stmt);
+    }
+
+    return stale;
+}
+
+int database_search_create_schema(sqlite3* db)
+{
+    char* err_msg = 0;
+    unsigned int stale = database_search_stale(db);
+
+    int rc = sqlite3_exec(
+        db,
+        "SAVEPOINT search_schema;"
+        "CREATE VIRTUAL TABLE IF NOT EXISTS asset_names USING fts5(name, kind UNINDEXED, asset_id UNINDEXED, tokenize='trigram');"
+        "CREATE VIRTUAL TABLE IF NOT EXISTS asset_names_vocab USING fts5vocab(asset_names, 'row');"
+        "CREATE TABLE IF NOT EXISTS asset_name_keys(rowid INTEGER PRIMARY KEY, kind INT, asset_id TEXT);"
+        "CREATE UNIQUE INDEX IF NOT EXISTS asset_name_keys_asset ON asset_name_keys(kind, asset_id);",
+        0, 0, &err_msg
+    );
+
+    if (rc == SQLITE_OK && stale)
+    {
+        database_search_drop_triggers(db);
+        rc = sqlite3_exec(db, "DELETE FROM asset_names; DELETE FROM asset_name_keys;", 0, 0, &err_msg);
+    }
+
+    for (int i = 0; i < DATABASE_SEARCH_KINDS && rc == SQLITE_OK; i++)
+    {
+        const char* table = database_search_tables[i];
+        int kind = 1 << i;
+        char sql[2048];
+
+        // asset_name_keys gives every asset an explicit rowid, a VACUUM
+        // renumbering the source rows cannot point it at another asset
+        sprintf(
+            sql,
+            "CREATE TRIGGER IF NOT EXISTS %s_names_insert AFTER INSERT ON %s BEGIN "
+            "INSERT INTO asset_name_keys(kind, asset_id) VALUES(%d, new.id);"
+            "INSERT INTO asset_names(rowid, name, kind, asset_id) VALUES(last_insert_rowid(), new.name, %d, new.id); END;"
+            "CREATE TRIGGER IF NOT EXISTS %s_names_update AFTER UPDATE OF id, name ON %s BEGIN "
+            "DELETE FROM asset_names WHERE rowid = (SELECT rowid FROM asset_name_keys WHERE kind = %d AND asset_id = old.id);"
+            "DELETE FROM asset_name_keys WHERE kind = %d AND asset_id = old.id;"
+            "INSERT INTO asset_name_keys(kind, asset_id) VALUES(%d, new.id);"
+            "INSERT INTO asset_names(rowid, name, kind, asset_id) VALUES(last_insert_rowid(), new.name, %d, new.id); END;"
+            "CREATE TRIGGER IF NOT EXISTS %s_names_delete AFTER DELETE ON %s BEGIN "
+            "DELETE FROM asset_names WHERE rowid = (SELECT rowid FROM asset_name_keys WHERE kind = %d AND asset_id = old.id);"
+            "DELETE FROM asset_name_keys WHERE kind = %d AND asset_id = old.id; END;",
+            table, table, kind, kind,
+            table, table, kind, kind, kind, kind,
+            table, table, kind, kind
+        );
+
+        rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+
+        if (rc == SQLITE_OK && stale)
+        {
+            sprintf(
+                sql,
+                "INSERT OR IGNORE INTO asset_name_keys(kind, asset_id) SELECT %d, id FROM %s;"
+                "INSERT INTO asset_names(rowid, name, kind, asset_id)"
+                " SELECT asset_name_keys.rowid, %s.name, %d, %s.id FROM %s"
+                " JOIN asset_name_keys ON asset_name_keys.kind = %d AND asset_name_keys.asset_id = %s.id;",
+                kind, table,
+                table, kind, table, table,
+                kind, table
+            );
+
+            rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+        }
+    }
+
+    if (rc == SQLITE_OK)
+        return sqlite3_exec(db, "RELEASE search_schema;", 0, 0, 0);
+
+    printf("ERROR creating asset search index, searching is disabled: %s\n", err_msg);
+    sqlite3_free(err_msg);
+
+    sqlite3_exec(db, "ROLLBACK TO search_schema; RELEASE search_schema;", 0, 0, 0);
+    database_search_drop_triggers(db);
+
+    return rc;
+}
+
+/**
+ * Appends text as a quoted FTS5 string, quotes are doubled.
+ */
+static void database_search_append_string(char* match, const char* text, size_t length)
+{
+    size_t size = strlen(match);
+    match[size++] = '"';
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (text[i] == '"')
+            match[size++] = '"';
+
+        match[size++] = text[i];
+    }
+
+    match[size++] = '"';
+    match[size] = '\0';
+}
+
+/**
+ * Appends text to a LIKE pattern, escaping the wildcards with a backslash.
+ */
+static void database_search_append_pattern(char* pattern, const char* text, size_t length)
+{
+    size_t size = strlen(pattern);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (text[i] == '%' || text[i] == '_' || text[i] == '\\')
+            pattern[size++] = '\\';
+
+        pattern[size++] = text[i];
+    }
+
+    pattern[size] = '\0';
+}
+
+/**
+ * Index of the character after the one at i, trigrams count UTF-8
+ * characters rather than bytes.
+ */
+static size_t database_search_next_char(const char* text, size_t i)
+{
+    i++;
+
+    while ((text[i] & 0xC0) == 0x80)
+        i++;
+
+    return i;
+}
+
+static size_t database_search_characters(const char* text, size_t length)
+{
+    size_t characters = 0;
+
+    for (size_t i = 0; i < length; i = database_search_next_char(text, i))
+        characters++;
+
+    return characters;
+}
+
+/**
+ * Builds the fuzzy pass query out of the word's trigrams that are not too
+ * common, OR'd together so names sharing most of them rank first.
+ */
+static void database_search_append_trigrams(sqlite3_stmt* vocab_stmt, char* fuzzy, const char* word, size_t length)
+{
+    size_t start = 0;
+
+    while (start < length)
+    {
+        size_t end = start;
+        int characters = 0;
+
+        while (characters < 3 && end < length)
+        {
+            end = database_search_next_char(word, end);
+            characters++;
+        }
+
+        if (characters < 3)
+            break;
+
+        char* trigram = calloc(end - start + 1, sizeof(char));
+
+        for (size_t i = start; i < end; i++)
+            trigram[i - start] = tolower((unsigned char) word[i]);
+
+        sqlite3_bind_text(vocab_stmt, 1, trigram, -1, SQLITE_STATIC);
+        int names = sqlite3_step(vocab_stmt) == SQLITE_ROW ? sqlite3_column_int(vocab_stmt, 0) : 0;
+        sqlite3_reset(vocab_stmt);
+
+        if (names > 0 && names <= DATABASE_SEARCH_FUZZY_MAX_NAMES)
+        {
+            if (fuzzy[0] != '\0')
+                strcat(fuzzy, " OR ");
+
+            database_search_append_string(fuzzy, trigram, end - start);
+        }
+
+        free(trigram);
+        start = database_search_next_char(word, start);
+    }
+}
+
+static unsigned int database_search_contains(dynamic_list_T* database_assets, const char* id, int kind)
+{
+    for (int i = 0; i < database_assets->size; i++)
+    {
+        database_asset_T* database_asset = (database_asset_T*) database_assets->items[i];
+
+        if (database_asset->id == id && database_asset->kind == kind)
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Runs one search pass, match may be empty and patterns holds
+ * patterns_size LIKE patterns every name has to satisfy.
+ */
+static void database_search_run(
+    database_T* database,
+    dynamic_list_T* database_assets,
+    int kinds,
+    const char* match,
+    char** patterns,
+    int patterns_size,
+    const char* prefix,
+    int limit
+)
+{
+    char* sql = calloc(256 + strlen(" AND name LIKE ? ESCAPE '\\'") * patterns_size, sizeof(char));
+    strcpy(sql, "SELECT kind, asset_id, name FROM asset_names WHERE (kind & ?) != 0");
+
+    if (match[0] != '\0')
+        strcat(sql, " AND asset_names MATCH ?");
+
+    for (int i = 0; i < patterns_size; i++)
+        strcat(sql, " AND name LIKE ? ESCAPE '\\'");
+
+    strcat(sql, match[0] != '\0' ? " ORDER BY name LIKE ? ESCAPE '\\' DESC, rank LIMIT ?" : " ORDER BY name LIKE ? ESCAPE '\\' DESC, name LIMIT ?");
+
+    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    free(sql);
+
+    if (stmt == (void*) 0)
+        return;
+
+    int parameter = 1;
+    sqlite3_bind_int(stmt, parameter++, kinds);
+
+    if (match[0] != '\0')
+        sqlite3_bind_text(stmt, parameter++, match, -1, SQLITE_STATIC);
+
+    for (int i = 0; i < patterns_size; i++)
+        sqlite3_bind_text(stmt, parameter++, patterns[i], -1, SQLITE_STATIC);
+
+    sqlite3_bind_text(stmt, parameter++, prefix, -1, SQLITE_STATIC);
+
+    // earlier rows coming back again still leave limit minus size new ones
+    sqlite3_bind_int(stmt, parameter++, limit);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW && database_assets->size < limit)
+    {
+        int kind = sqlite3_column_int(stmt, 0);
+        char* id = database_column_intern(database, stmt, 1);
+
+        if (database_search_contains(database_assets, id, kind))
+            continue;
+
+        dynamic_list_append(database_assets, init_database_asset(kind, id, database_column_intern(database, stmt, 2)));
+    }
+
+    database_finalize(database, stmt);
+}
+
+dynamic_list_T* database_search_assets(database_T* database, const char* query, int kinds, int limit)
+{
+    dynamic_list_T* database_assets = init_dynamic_list(sizeof(struct DATABASE_ASSET_STRUCT*));
+
+    if (!database->searchable)
+        return database_assets;
+
+    size_t query_length = strlen(query);
+
+    // every character may get escaped and every word quoted
+    size_t capacity = query_length * 8 + 4;
+    char* match = calloc(capacity, sizeof(char));
+    char* fuzzy = calloc(capacity * 3, sizeof(char));
+    char* prefix = calloc(query_length * 2 + 2, sizeof(char));
+    char** patterns = calloc(query_length + 1, sizeof(char*));
+    int patterns_size = 0;
+
+    database_search_append_pattern(prefix, query, query_length);
+    strcat(prefix, "%");
+
+    sqlite3_stmt* vocab_stmt = database_exec_sql(database, "SELECT doc FROM asset_names_vocab WHERE term = ?", 0);
+    size_t i = 0;
+
+    while (i < query_length)
+    {
+        while (i < query_length && isspace((unsigned char) query[i]))
+            i++;
+
+        size_t start = i;
+
+        while (i < query_length && !isspace((unsigned char) query[i]))
+            i++;
+
+        size_t length = i - start;
+
+        if (length == 0)
+            break;
+
+        // the trigram index only answers words of three characters or more
+        if (database_search_characters(&query[start], length) >= 3)
+        {
+            if (match[0] != '\0')
+                strcat(match, " AND ");
+
+            database_search_append_string(match, &query[start], length);
+        }
+        else
+        {
+            patterns[patterns_size] = calloc(length * 2 + 3, sizeof(char));
+            strcpy(patterns[patterns_size], "%");
+            database_search_append_pattern(patterns[patterns_size], &query[start], length);
+            strcat(patterns[patterns_size], "%");
+            patterns_size++;
+        }
+
+        if (vocab_stmt != (void*) 0)
+            database_search_append_trigrams(vocab_stmt, fuzzy, &query[start], length);
+    }
+
+    database_finalize(database, vocab_stmt);
+
+    if (match[0] != '\0' || patterns_size > 0)
+        database_search_run(database, database_assets, kinds, match, patterns, patterns_size, prefix, limit);
+
+    if (database_assets->size < limit && fuzzy[0] != '\0')
+        database_search_run(database, database_assets, kinds, fuzzy, (void*) 0, 0, prefix, limit);
+
+    for (int j = 0; j < patterns_size; j++)
+        free(patterns[j]);
+
+    free(patterns);
+    free(prefix);
+    free(fuzzy);
+    free(match);
+
+    return database_assets;
+}
@@ -0,0 +1,215 @@
+#include "include/database_thumbnails.h"
+#include "include/database_memory.h"
+#include <coelum/sprite.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+static database_thumbnail_T* init_database_thumbnail(int width, int height)
+{
+    database_thumbnail_T* database_thumbnail = calloc(1, sizeof(struct DATABASE_THUMBNAIL_STRUCT));
+    database_thumbnail->width = width;
+    database_thumbnail->height = height;
+    database_thumbnail->pixels = calloc((size_t) width * height * 4, sizeof(unsigned char));
+    database_memory_track_alloc(DATABASE_MEMORY_SPRITE_PIXELS, (size_t) width * height * 4);
+
+    return database_thumbnail;
+}
+
+/**
+ * Box filter, every thumbnail pixel averages the frame pixels it covers.
+ */
+database_thumbnail_T* init_database_thumbnail_from_texture(texture_T* texture)
+{
+    int width = texture->width;
+    int height = texture->height;
+    int longest = width > height ? width : height;
+
+    if (longest > DATABASE_THUMBNAIL_SIZE)
+    {
+        width = width * DATABASE_THUMBNAIL_SIZE / longest;
+        height = height * DATABASE_THUMBNAIL_SIZE / longest;
+    }
+
+    if (width < 1)
+        width = 1;
+
+    if (height < 1)
+        height = 1;
+
+    database_thumbnail_T* database_thumbnail = init_database_thumbnail(width, height);
+
+    for (int y = 0; y < height; y++)
+    {
+        int y0 = y * texture->height / height;
+        int y1 = (y + 1) * texture->height / height;
+
+        if (y1 <= y0)
+            y1 = y0 + 1;
+
+        for (int x = 0; x < width; x++)
+        {
+            int x0 = x * texture->width / width;
+            int x1 = (x + 1) * texture->width / width;
+
+            if (x1 <= x0)
+                x1 = x0 + 1;
+
+            unsigned int sums[4] = { 0 };
+
+            for (int sy = y0; sy < y1; sy++)
+            {
+                const unsigned char* row = &texture->data[((size_t) sy * texture->width + x0) * 4];
+
+                for (int sx = 0; sx < (x1 - x0) * 4; sx++)
+                    sums[sx % 4] += row[sx];
+            }
+
+            unsigned int count = (x1 - x0) * (y1 - y0);
+            unsigned char* pixel = &database_thumbnail->pixels[((size_t) y * width + x) * 4];
+
+            for (int c = 0; c < 4; c++)
+                pixel[c] = sums[c] / count;
+        }
+    }
+
+    return database_thumbnail;
+}
+
+void database_thumbnail_free(database_thumbnail_T* database_thumbnail)
+{
+    database_memory_track_free(
+        DATABASE_MEMORY_SPRITE_PIXELS,
+        (size_t) database_thumbnail->width * database_thumbnail->height * 4
+    );
+
+    free(database_thumbnail->pixels);
+    free(database_thumbnail);
+}
+
+int database_store_sprite_thumbnail(sqlite3* db, const char* sprite_id, database_thumbnail_T* database_thumbnail)
+{
+    sqlite3_stmt* stmt;
+
+    int rc = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO sprite_thumbnails VALUES(?, ?, ?, ?)", -1, &stmt, NULL);
+
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, sprite_id, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, database_thumbnail->width);
+        sqlite3_bind_int(stmt, 3, database_thumbnail->height);
+        sqlite3_bind_blob(
+            stmt,
+            4,
+            database_thumbnail->pixels,
+            database_thumbnail->width * database_thumbnail->height * 4,
+            SQLITE_STATIC
+        );
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+    }
+
+    if (rc != SQLITE_OK)
+        printf("ERROR storing thumbnail: %s\n", sqlite3_errmsg(db));
+
+    sqlite3_finalize(stmt);
+
+    return rc;
+}
+
+typedef struct DATABASE_THUMBNAIL_WRITE_STRUCT
+{
+    const char* sprite_id;
+    database_thumbnail_T* database_thumbnail;
+} database_thumbnail_write_T;
+
+static int database_run_thumbnail_write(sqlite3* db, void* user_data)
+{
+    database_thumbnail_write_T* write = (database_thumbnail_write_T*) user_data;
+
+    return database_store_sprite_thumbnail(db, write->sprite_id, write->database_thumbnail);
+}
+
+/**
+ * Decodes only the first frame: its own frame file for sprites stored by
+ * frame, the legacy sprite file otherwise.
+ */
+static database_thumbnail_T* database_make_sprite_thumbnail(database_T* database, const char* sprite_id)
+{
+    sqlite3_stmt* stmt = database_exec_sql(
+        database,
+        "SELECT coalesce(frames.filepath, sprites.filepath) FROM sprites"
+        " LEFT JOIN sprite_frames ON sprite_frames.sprite_id = sprites.id AND sprite_frames.frame = 0"
+        " LEFT JOIN frames ON frames.hash = sprite_frames.hash"
+        " WHERE sprites.id=?",
+        0
+    );
+
+    if (stmt == (void*) 0)
+        return (void*) 0;
+
+    sqlite3_bind_text(stmt, 1, sprite_id, -1, SQLITE_STATIC);
+
+    sprite_T* sprite = (void*) 0;
+
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0) != (void*) 0)
+        sprite = load_sprite_from_disk((const char*) sqlite3_column_text(stmt, 0));
+
+    database_finalize(database, stmt);
+
+    if (sprite == (void*) 0)
+        return (void*) 0;
+
+    database_thumbnail_T* database_thumbnail = (void*) 0;
+
+    if (sprite->textures->size > 0)
+        database_thumbnail = init_database_thumbnail_from_texture((texture_T*) sprite->textures->items[0]);
+
+    sprite_free(sprite);
+
+    if (database_thumbnail != (void*) 0)
+    {
+        database_thumbnail_write_T write;
+        write.sprite_id = sprite_id;
+        write.database_thumbnail = database_thumbnail;
+
+        database_submit_write(database, database_run_thumbnail_write, &write);
+    }
+
+    return database_thumbnail;
+}
+
+database_thumbnail_T* database_get_sprite_thumbnail(database_T* database, const char* sprite_id)
+{
+    sqlite3_stmt* stmt = database_exec_sql(
+        database,
+        "SELECT width, height, pixels FROM sprite_thumbnails WHERE sprite_id=?",
+        0
+    );
+
+    if (stmt == (void*) 0)
+        return (void*) 0;
+
+    sqlite3_bind_text(stmt, 1, sprite_id, -1, SQLITE_STATIC);
+
+    database_thumbnail_T* database_thumbnail = (void*) 0;
+
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int width = sqlite3_column_int(stmt, 0);
+        int height = sqlite3_column_int(stmt, 1);
+
+        if (sqlite3_column_bytes(stmt, 2) == width * height * 4)
+        {
+            database_thumbnail = init_database_thumbnail(width, height);
+            memcpy(database_thumbnail->pixels, sqlite3_column_blob(stmt, 2), (size_t) width * height * 4);
+        }
+    }
+
+    database_finalize(database, stmt);
+
+    if (database_thumbnail == (void*) 0)
+        database_thumbnail = database_make_sprite_thumbnail(database, sprite_id);
+
+    return database_thumbnail;
+}
@@ -0,0 +1,672 @@
+#include "include/database_transfer.h"
+#include "include/file_utils.h"
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+typedef struct DATABASE_TRANSFER_FIELD_STRUCT
+{
+    char* key;
+    char* value;
+    unsigned int is_null;
+} database_transfer_field_T;
+
+static void database_transfer_write_string(FILE* file, const char* text)
+{
+    fputc('"', file);
+
+    for (const unsigned char* c = (const unsigned char*) text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(file, "\\u%04x", *c);
+        else
+            fputc(*c, file);
+    }
+
+    fputc('"', file);
+}
+
+/**
+ * Writes the row stmt is on, the table's columns starting at first_column.
+ */
+static void database_transfer_write_row(FILE* file, const database_table_T* table, sqlite3_stmt* stmt, int first_column)
+{
+    fprintf(file, "{\"type\":\"%s\"", table->name);
+
+    for (size_t i = 0; i < table->columns_size; i++)
+    {
+        const database_column_T* column = &table->columns[i];
+        int index = first_column + i;
+
+        fprintf(file, ",\"%s\":", column->name);
+
+        if (column->kind == DATABASE_COLUMN_INT)
+            fprintf(file, "%d", sqlite3_column_int(stmt, index));
+        else if (column->kind == DATABASE_COLUMN_FLOAT)
+            fprintf(file, "%.9g", sqlite3_column_double(stmt, index));
+        else if (sqlite3_column_type(stmt, index) == SQLITE_NULL)
+            fprintf(file, "null");
+        else
+            database_transfer_write_string(file, (const char*) sqlite3_column_text(stmt, index));
+    }
+
+    fprintf(file, "}\n");
+}
+
+static int database_export_scene(database_T* database, const char* scene_id, intern_table_T* actor_definition_ids, FILE* file)
+{
+    char* sql = database_table_select_sql(&database_scenes_table, (void*) 0, (void*) 0, "WHERE id=?");
+    sqlite3_stmt* stmt = database_exec_sql(database, sql, 0);
+    free(sql);
+
+    if (stmt == (void*) 0)
+        return SQLITE_ERROR;
+
+    sqlite3_bind_text(stmt, 1, scene_id, -1, SQLITE_TRANSIENT);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW)
+    {
+        printf("ERROR exporting scene %s: no such scene\n", scene_id);
+        database_finalize(database, stmt);
+        return SQLITE_NOTFOUND;
+    }
+
+    database_transfer_write_row(file, &database_scenes_table, stmt, 0);
+    database_finalize(database, stmt);
+
+    // the scene file is attached next to main, so definitions are picked in one query
+    char* schema = database_get_scene_schema(database, scene_id);
+    char* clause = calloc(strlen("WHERE id IN (SELECT actor_definition_id FROM .actor_instances WHERE scene_id=?)") + strlen(schema) + 1, sizeof(char));
+    sprintf(clause, "WHERE id IN (SELECT actor_definition_id FROM %s.actor_instances WHERE scene_id=?)", schema);
+    sql = database_table_select_sql(&database_actor_definitions_table, "main", (void*) 0, clause);
+    free(clause);
+    free(schema);
+
+    stmt = database_exec_scene_sql(database, scene_id, sql, 0);
+    free(sql);
+
+    // a shard that was never written has no instances to export
+    if (stmt == (void*) 0)
+        return SQLITE_OK;
+
+    sqlite3_bind_text(stmt, 1, scene_id, -1, SQLITE_TRANSIENT);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* id = (const char*) sqlite3_column_text(stmt, 0);
+
+        if (id == (void*) 0 || intern_table_find(actor_definition_ids, id) != (void*) 0)
+            continue;
+
+        intern_table_intern(actor_definition_ids, id);
+        database_transfer_write_row(file, &database_actor_definitions_table, stmt, 0);
+    }
+
+    database_finalize_scene(database, scene_id, stmt);
+
+    stmt = database_prepare_actor_instances_by_scene_id(database, scene_id);
+
+    if (stmt == (void*) 0)
+        return SQLITE_OK;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        database_transfer_write_row(file, &database_actor_instances_table, stmt, 0);
+
+    database_finalize_scene(database, scene_id, stmt);
+
+    return ferror(file) ? SQLITE_IOERR : SQLITE_OK;
+}
+
+int database_export_scenes(database_T* database, const char** scene_ids, size_t scene_ids_size, FILE* file)
+{
+    // the ids of the definitions written so far, as a set
+    intern_table_T* actor_definition_ids = init_intern_table();
+    int rc = SQLITE_OK;
+
+    for (size_t i = 0; i < scene_ids_size && rc == SQLITE_OK; i++)
+        rc = database_export_scene(database, scene_ids[i], actor_definition_ids, file);
+
+    intern_table_free(actor_definition_ids);
+
+    fflush(file);
+
+    return rc;
+}
+
+static char* database_transfer_skip_whitespace(char* c)
+{
+    while (isspace((unsigned char) *c))
+        c++;
+
+    return c;
+}
+
+static char* database_transfer_encode_utf8(char* out, unsigned long codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        *out++ = codepoint;
+    }
+    else if (codepoint < 0x800)
+    {
+        *out++ = 0xC0 | (codepoint >> 6);
+        *out++ = 0x80 | (codepoint & 0x3F);
+    }
+    else if (codepoint < 0x10000)
+    {
+        *out++ = 0xE0 | (codepoint >> 12);
+        *out++ = 0x80 | ((codepoint >> 6) & 0x3F);
+        *out++ = 0x80 | (codepoint & 0x3F);
+    }
+    else
+    {
+        *out++ = 0xF0 | (codepoint >> 18);
+        *out++ = 0x80 | ((codepoint >> 12) & 0x3F);
+        *out++ = 0x80 | ((codepoint >> 6) & 0x3F);
+        *out++ = 0x80 | (codepoint & 0x3F);
+    }
+
+    return out;
+}
+
+/**
+ * Decodes the string starting at *cursor (just past its opening quote) in
+ * place, unescaped text is never longer than the escaped text.
+ * Leaves *cursor after the closing quote, NULL on malformed input.
+ */
+static char* database_transfer_parse_string(char** cursor)
+{
+    char* in = *cursor;
+    char* out = in;
+    char* value = in;
+
+    while (*in != '"')
+    {
+        if (*in == '\0')
+            return (void*) 0;
+
+        if (*in != '\\')
+        {
+            *out++ = *in++;
+            continue;
+        }
+
+        in++;
+
+        if (*in == 'u')
+        {
+            char hex[5] = { 0 };
+            strncpy(hex, in + 1, 4);
+
+            if (strlen(hex) < 4)
+                return (void*) 0;
+
+            unsigned long codepoint = strtoul(hex, (void*) 0, 16);
+            in += 5;
+
+            // surrogate pairs come as two escapes
+            if (codepoint >= 0xD800 && codepoint < 0xDC00 && in[0] == '\\' && in[1] == 'u')
+            {
+                strncpy(hex, in + 2, 4);
+                unsigned long low = strtoul(hex, (void*) 0, 16);
+
+                if (low >= 0xDC00 && low < 0xE000)
+                {
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    in += 6;
+                }
+            }
+
+            out = database_transfer_encode_utf8(out, codepoint);
+            continue;
+        }
+
+        if (*in == 'n')
+            *out++ = '\n';
+        else if (*in == 't')
+            *out++ = '\t';
+        else if (*in == 'r')
+            *out++ = '\r';
+        else if (*in == 'b')
+            *out++ = '\b';
+        else if (*in == 'f')
+            *out++ = '\f';
+        else if (*in == '\0')
+            return (void*) 0;
+        else
+            *out++ = *in;
+
+        in++;
+    }
+
+    *out = '\0';
+    *cursor = in + 1;
+
+    return value;
+}
+
+/**
+ * Splits a flat JSON object into fields, in place.
+ * Returns the number of fields or -1 when the line is not such an object.
+ */
+static int database_transfer_parse_line(char* line, database_transfer_field_T* fields)
+{
+    char* c = database_transfer_skip_whitespace(line);
+    int fields_size = 0;
+
+    if (*c++ != '{')
+        return -1;
+
+    c = database_transfer_skip_whitespace(c);
+
+    if (*c == '}')
+        return 0;
+
+    while (fields_size < DATABASE_TRANSFER_MAX_FIELDS)
+    {
+        database_transfer_field_T* field = &fields[fields_size++];
+
+        if (*c++ != '"' || (field->key = database_transfer_parse_string(&c)) == (void*) 0)
+            return -1;
+
+        c = database_transfer_skip_whitespace(c);
+
+        if (*c++ != ':')
+            return -1;
+
+        c = database_transfer_skip_whitespace(c);
+        unsigned int quoted = *c == '"';
+
+        if (quoted)
+        {
+            c++;
+
+            if ((field->value = database_transfer_parse_string(&c)) == (void*) 0)
+                return -1;
+
+            c = database_transfer_skip_whitespace(c);
+        }
+        else
+        {
+            field->value = c;
+
+            while (*c != '\0' && *c != ',' && *c != '}' && !isspace((unsigned char) *c))
+                c++;
+
+            // terminating the literal overwrites what follows it, skip over that first
+            if (isspace((unsigned char) *c))
+            {
+                *c++ = '\0';
+                c = database_transfer_skip_whitespace(c);
+            }
+        }
+
+        char delimiter = *c;
+
+        if (delimiter != '\0')
+            *c++ = '\0';
+
+        field->is_null = !quoted && strcmp(field->value, "null") == 0;
+
+        if (delimiter == '}')
+            return fields_size;
+
+        if (delimiter != ',')
+            return -1;
+
+        c = database_transfer_skip_whitespace(c);
+    }
+
+    return -1;
+}
+
+static database_transfer_field_T* database_transfer_find(database_transfer_field_T* fields, int fields_size, const char* key)
+{
+    for (int i = 0; i < fields_size; i++)
+    {
+        if (strcmp(fields[i].key, key) == 0)
+            return &fields[i];
+    }
+
+    return (void*) 0;
+}
+
+/**
+ * A scene file the import writes to through a connection of its own, in a
+ * transaction of its own that stays open until the end of the input.
+ */
+typedef struct DATABASE_IMPORT_SHARD_STRUCT
+{
+    char* scene_id;
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+    // the file did not exist before the import
+    unsigned int created;
+} database_import_shard_T;
+
+typedef struct DATABASE_IMPORT_STRUCT
+{
+    database_T* database;
+    FILE* file;
+    sqlite3_stmt* exists_stmts[2];
+    sqlite3_stmt* insert_stmts[2];
+    sqlite3_stmt* instance_stmt;
+    // every scene file written to, open until the import commits
+    dynamic_list_T* shards;
+    database_import_shard_T* shard;
+    intern_table_T* skipped_scene_ids;
+} database_import_T;
+
+/**
+ * Binds the table's columns from the fields of the same name, a column
+ * without a field is NULL like it would be for a missing struct value.
+ */
+static void database_transfer_bind(
+    sqlite3_stmt* stmt,
+    const database_table_T* table,
+    database_transfer_field_T* fields,
+    int fields_size
+)
+{
+    for (size_t i = 0; i < table->columns_size; i++)
+    {
+        const database_column_T* column = &table->columns[i];
+        database_transfer_field_T* field = database_transfer_find(fields, fields_size, column->name);
+        int parameter = i + 1;
+
+        if (field == (void*) 0 || field->is_null)
+        {
+            if (column->kind == DATABASE_COLUMN_OPTIONAL_TEXT)
+                sqlite3_bind_text(stmt, parameter, "", -1, SQLITE_STATIC);
+            else
+                sqlite3_bind_null(stmt, parameter);
+        }
+        else if (column->kind == DATABASE_COLUMN_INT)
+        {
+            sqlite3_bind_int(stmt, parameter, strcmp(field->value, "true") == 0 ? 1 : atoi(field->value));
+        }
+        else if (column->kind == DATABASE_COLUMN_FLOAT)
+        {
+            sqlite3_bind_double(stmt, parameter, strtod(field->value, (void*) 0));
+        }
+        else
+        {
+            sqlite3_bind_text(stmt, parameter, field->value, -1, SQLITE_STATIC);
+        }
+    }
+}
+
+/**
+ * Commits the transaction of every scene file, or rolls it back, and
+ * closes them. Scene files the import created are removed again unless
+ * committed. Stops committing at the first failure and rolls back the rest.
+ */
+static int database_import_close_shards(database_import_T* import, unsigned int commit)
+{
+    int rc = commit ? SQLITE_OK : SQLITE_ABORT;
+
+    for (int i = 0; i < import->shards->size; i++)
+    {
+        database_import_shard_T* shard = (database_import_shard_T*) import->shards->items[i];
+
+        sqlite3_finalize(shard->stmt);
+
+        if (rc == SQLITE_OK)
+        {
+            rc = sqlite3_exec(shard->db, "COMMIT", 0, 0, 0);
+
+            if (rc != SQLITE_OK)
+                printf("ERROR importing scene %s: %s\n", shard->scene_id, sqlite3_errmsg(shard->db));
+        }
+
+        if (rc != SQLITE_OK)
+            sqlite3_exec(shard->db, "ROLLBACK", 0, 0, 0);
+
+        sqlite3_close(shard->db);
+
+        if (rc != SQLITE_OK && shard->created)
+        {
+            char* filepath = database_get_scene_filepath(import->database, shard->scene_id);
+
+            if (access(filepath, F_OK) == 0)
+                delete_file(filepath);
+
+            free(filepath);
+        }
+
+        free(shard->scene_id);
+        free(shard);
+    }
+
+    import->shards->size = 0;
+    import->shard = (void*) 0;
+
+    return commit ? rc : SQLITE_OK;
+}
+
+/**
+ * Scene files are written through connections of their own instead of
+ * being attached, SQLite only attaches a handful at once. Each keeps its
+ * transaction open so a failing line rolls every one of them back.
+ */
+static sqlite3_stmt* database_import_instance_stmt(database_import_T* import, const char* scene_id)
+{
+    database_T* database = import->database;
+
+    if (!(database->flags & DATABASE_SHARD_SCENES))
+        return import->instance_stmt;
+
+    // instances come grouped by scene, the list is only searched when the scene changes
+    if (import->shard != (void*) 0 && strcmp(import->shard->scene_id, scene_id) == 0)
+        return import->shard->stmt;
+
+    for (int i = 0; i < import->shards->size; i++)
+    {
+        database_import_shard_T* shard = (database_import_shard_T*) import->shards->items[i];
+
+        if (strcmp(shard->scene_id, scene_id) == 0)
+        {
+            import->shard = shard;
+            return shard->stmt;
+        }
+    }
+
+    char* filepath = database_get_scene_filepath(database, scene_id);
+    unsigned int created = access(filepath, F_OK) != 0;
+    free(filepath);
+
+    sqlite3* db = database_open_scene(database, scene_id);
+
+    if (db == (void*) 0)
+        return (void*) 0;
+
+    database_import_shard_T* shard = calloc(1, sizeof(struct DATABASE_IMPORT_SHARD_STRUCT));
+    shard->scene_id = calloc(strlen(scene_id) + 1, sizeof(char));
+    strcpy(shard->scene_id, scene_id);
+    shard->db = db;
+    shard->created = created;
+    dynamic_list_append(import->shards, shard);
+
+    char* sql = database_table_insert_sql(&database_actor_instances_table, (void*) 0);
+    int rc = sqlite3_exec(db, "BEGIN", 0, 0, 0);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_prepare_v2(db, sql, -1, &shard->stmt, NULL);
+
+    free(sql);
+
+    if (rc != SQLITE_OK)
+    {
+        printf("ERROR importing scene %s: %s\n", scene_id, sqlite3_errmsg(db));
+        return (void*) 0;
+    }
+
+    import->shard = shard;
+
+    return shard->stmt;
+}
+
+/**
+ * Imports one parsed line, scenes and definitions at index 0 and 1 of the
+ * statement arrays.
+ */
+static int database_import_row(database_import_T* import, sqlite3* db, database_transfer_field_T* fields, int fields_size)
+{
+    database_transfer_field_T* type = database_transfer_find(fields, fields_size, "type");
+    database_transfer_field_T* id = database_transfer_find(fields, fields_size, "id");
+
+    if (type == (void*) 0 || id == (void*) 0 || id->is_null)
+        return SQLITE_MISMATCH;
+
+    const database_table_T* tables[] = { &database_scenes_table, &database_actor_definitions_table };
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (strcmp(type->value, tables[i]->name) != 0)
+            continue;
+
+        sqlite3_bind_text(import->exists_stmts[i], 1, id->value, -1, SQLITE_STATIC);
+        unsigned int exists = sqlite3_step(import->exists_stmts[i]) == SQLITE_ROW;
+        sqlite3_reset(import->exists_stmts[i]);
+
+        if (exists)
+        {
+            if (i == 0)
+                intern_table_intern(import->skipped_scene_ids, id->value);
+
+            return SQLITE_OK;
+        }
+
+        database_transfer_bind(import->insert_stmts[i], tables[i], fields, fields_size);
+        int rc = sqlite3_step(import->insert_stmts[i]) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+
+        if (rc != SQLITE_OK)
+            printf("ERROR importing %s: %s\n", tables[i]->name, sqlite3_errmsg(db));
+
+        sqlite3_reset(import->insert_stmts[i]);
+
+        return rc;
+    }
+
+    if (strcmp(type->value, database_actor_instances_table.name) != 0)
+        return SQLITE_MISMATCH;
+
+    database_transfer_field_T* scene_id = database_transfer_find(fields, fields_size, "scene_id");
+
+    if (scene_id == (void*) 0 || scene_id->is_null)
+        return SQLITE_MISMATCH;
+
+    if (intern_table_find(import->skipped_scene_ids, scene_id->value) != (void*) 0)
+        return SQLITE_OK;
+
+    sqlite3_stmt* stmt = database_import_instance_stmt(import, scene_id->value);
+
+    if (stmt == (void*) 0)
+        return SQLITE_CANTOPEN;
+
+    database_transfer_bind(stmt, &database_actor_instances_table, fields, fields_size);
+    int rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+    sqlite3_reset(stmt);
+
+    if (rc != SQLITE_OK)
+        printf("ERROR importing instance: %s\n", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+
+    return rc;
+}
+
+static int database_run_import(sqlite3* db, void* user_data)
+{
+    database_import_T* import = (database_import_T*) user_data;
+    database_transfer_field_T fields[DATABASE_TRANSFER_MAX_FIELDS];
+    char* line = (void*) 0;
+    size_t line_size = 0;
+    unsigned int line_number = 0;
+    int rc = SQLITE_OK;
+
+    sqlite3_exec(db, "BEGIN", 0, 0, 0);
+
+    const database_table_T* insert_tables[] = {
+        &database_scenes_table,
+        &database_actor_definitions_table,
+        &database_actor_instances_table
+    };
+    sqlite3_stmt** insert_stmts[] = { &import->insert_stmts[0], &import->insert_stmts[1], &import->instance_stmt };
+
+    rc = sqlite3_prepare_v2(db, "SELECT 1 FROM scenes WHERE id=?", -1, &import->exists_stmts[0], NULL);
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_prepare_v2(db, "SELECT 1 FROM actor_definitions WHERE id=?", -1, &import->exists_stmts[1], NULL);
+
+    for (int i = 0; i < 3 && rc == SQLITE_OK; i++)
+    {
+        char* sql = database_table_insert_sql(insert_tables[i], (void*) 0);
+        rc = sqlite3_prepare_v2(db, sql, -1, insert_stmts[i], NULL);
+        free(sql);
+    }
+
+    if (rc != SQLITE_OK)
+        printf("ERROR preparing import: %s\n", sqlite3_errmsg(db));
+
+    // the line buffer only ever grows to the longest line
+    while (rc == SQLITE_OK && getline(&line, &line_size, import->file) != -1)
+    {
+        line_number++;
+
+        if (*database_transfer_skip_whitespace(line) == '\0')
+            continue;
+
+        int fields_size = database_transfer_parse_line(line, fields);
+
+        rc = fields_size < 0 ? SQLITE_MISMATCH : database_import_row(import, db, fields, fields_size);
+
+        if (rc == SQLITE_MISMATCH)
+            printf("ERROR importing line %u: malformed row\n", line_number);
+        else if (rc != SQLITE_OK)
+            printf("ERROR importing line %u\n", line_number);
+    }
+
+    free(line);
+
+    for (int i = 0; i < 2; i++)
+    {
+        sqlite3_finalize(import->exists_stmts[i]);
+        sqlite3_finalize(import->insert_stmts[i]);
+    }
+
+    sqlite3_finalize(import->instance_stmt);
+
+    // the scene files go first, main is only committed once they all are
+    int shard_rc = database_import_close_shards(import, rc == SQLITE_OK);
+
+    if (rc == SQLITE_OK)
+        rc = shard_rc;
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "COMMIT", 0, 0, 0);
+
+    if (rc != SQLITE_OK)
+        sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+
+    return rc;
+}
+
+int database_import_scenes(database_T* database, FILE* file)
+{
+    database_import_T import = { 0 };
+    import.database = database;
+    import.file = file;
+    import.shards = init_dynamic_list(sizeof(struct DATABASE_IMPORT_SHARD_STRUCT*));
+    import.skipped_scene_ids = init_intern_table();
+
+    int rc = database_submit_write(database, database_run_import, &import);
+
+    free(import.shards->items);
+    free(import.shards);
+    intern_table_free(import.skipped_scene_ids);
+
+    return rc;
+}
@@ -0,0 +1,137 @@
+#include "include/database_writer.h"
+#include <stdlib.h>
+#include <sched.h>
+
+
+static void database_writer_push(database_writer_T* database_writer, database_write_T* write)
+{
+    atomic_store_explicit(&write->next, (void*) 0, memory_order_relaxed);
+
+    database_write_T* prev = atomic_exchange_explicit(&database_writer->head, write, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, write, memory_order_release);
+}
+
+/**
+ * Returns NULL when the queue is empty or a producer is halfway through a push.
+ */
+static database_write_T* database_writer_pop(database_writer_T* database_writer)
+{
+    database_write_T* tail = database_writer->tail;
+    database_write_T* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &database_writer->stub)
+    {
+        if (next == (void*) 0)
+            return (void*) 0;
+
+        database_writer->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+
+    if (next != (void*) 0)
+    {
+        database_writer->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&database_writer->head, memory_order_acquire))
+        return (void*) 0;
+
+    database_writer_push(database_writer, &database_writer->stub);
+
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (next != (void*) 0)
+    {
+        database_writer->tail = next;
+        return tail;
+    }
+
+    return (void*) 0;
+}
+
+static void* database_writer_run(void* argument)
+{
+    database_writer_T* database_writer = (database_writer_T*) argument;
+
+    while (1)
+    {
+        sem_wait(&database_writer->pending);
+
+        database_write_T* write;
+
+        // every post matches one push, so the item is at most a push away
+        while ((write = database_writer_pop(database_writer)) == (void*) 0)
+            sched_yield();
+
+        if (write->callback == (void*) 0)
+        {
+            sem_post(&write->done);
+            break;
+        }
+
+        write->rc = write->callback(database_writer->db, write->user_data);
+
+        if (write->detached)
+            free(write);
+        else
+            sem_post(&write->done);
+    }
+
+    return (void*) 0;
+}
+
+database_writer_T* init_database_writer(sqlite3* db)
+{
+    database_writer_T* database_writer = calloc(1, sizeof(struct DATABASE_WRITER_STRUCT));
+    database_writer->db = db;
+    database_writer->tail = &database_writer->stub;
+    atomic_init(&database_writer->head, &database_writer->stub);
+    atomic_init(&database_writer->stub.next, (void*) 0);
+    sem_init(&database_writer->pending, 0, 0);
+
+    pthread_create(&database_writer->thread, (void*) 0, database_writer_run, database_writer);
+
+    return database_writer;
+}
+
+int database_writer_submit(database_writer_T* database_writer, database_write_callback callback, void* user_data)
+{
+    database_write_T write;
+    write.callback = callback;
+    write.user_data = user_data;
+    write.rc = SQLITE_OK;
+    write.detached = 0;
+    sem_init(&write.done, 0, 0);
+
+    database_writer_push(database_writer, &write);
+    sem_post(&database_writer->pending);
+
+    while (sem_wait(&write.done) != 0);
+
+    sem_destroy(&write.done);
+
+    return write.rc;
+}
+
+void database_writer_post(database_writer_T* database_writer, database_write_callback callback, void* user_data)
+{
+    database_write_T* write = calloc(1, sizeof(struct DATABASE_WRITE_STRUCT));
+    write->callback = callback;
+    write->user_data = user_data;
+    write->detached = 1;
+
+    database_writer_push(database_writer, write);
+    sem_post(&database_writer->pending);
+}
+
+void database_writer_free(database_writer_T* database_writer)
+{
+    database_writer_submit(database_writer, (void*) 0, (void*) 0);
+    pthread_join(database_writer->thread, (void*) 0);
+
+    sem_destroy(&database_writer->pending);
+    sqlite3_close(database_writer->db);
+    free(database_writer);
+}
@@ -0,0 +1,282 @@
+#include "include/definition_cache.h"
+#include "include/database.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+
+static size_t definition_cache_bucket(definition_cache_T* definition_cache, const char* key)
+{
+    uintptr_t hash = (uintptr_t) key;
+    hash ^= hash >> 17;
+    hash *= 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+
+    return hash & (definition_cache->bucket_count - 1);
+}
+
+definition_cache_T* init_definition_cache(size_t capacity)
+{
+    definition_cache_T* definition_cache = calloc(1, sizeof(struct DEFINITION_CACHE_STRUCT));
+    definition_cache->capacity = capacity;
+    definition_cache->bucket_count = 16;
+
+    while (definition_cache->bucket_count < capacity * 2)
+        definition_cache->bucket_count *= 2;
+
+    definition_cache->buckets_by_id = calloc(definition_cache->bucket_count, sizeof(definition_cache_entry_T*));
+    definition_cache->buckets_by_name = calloc(definition_cache->bucket_count, sizeof(definition_cache_entry_T*));
+    pthread_mutex_init(&definition_cache->lock, (void*) 0);
+
+    return definition_cache;
+}
+
+static void definition_cache_unlink(definition_cache_T* definition_cache, definition_cache_entry_T* entry)
+{
+    if (entry->prev != (void*) 0)
+        entry->prev->next = entry->next;
+    else
+        definition_cache->most_recent = entry->next;
+
+    if (entry->next != (void*) 0)
+        entry->next->prev = entry->prev;
+    else
+        definition_cache->least_recent = entry->prev;
+
+    entry->prev = (void*) 0;
+    entry->next = (void*) 0;
+}
+
+static void definition_cache_push_front(definition_cache_T* definition_cache, definition_cache_entry_T* entry)
+{
+    entry->next = definition_cache->most_recent;
+
+    if (definition_cache->most_recent != (void*) 0)
+        definition_cache->most_recent->prev = entry;
+    else
+        definition_cache->least_recent = entry;
+
+    definition_cache->most_recent = entry;
+}
+
+static database_actor_definition_T* definition_cache_hit(definition_cache_T* definition_cache, definition_cache_entry_T* entry)
+{
+    if (entry == (void*) 0)
+    {
+        definition_cache->misses += 1;
+        return (void*) 0;
+    }
+
+    definition_cache->hits += 1;
+
+    definition_cache_unlink(definition_cache, entry);
+    definition_cache_push_front(definition_cache, entry);
+
+    entry->database_actor_definition->references += 1;
+
+    return entry->database_actor_definition;
+}
+
+static definition_cache_entry_T* definition_cache_find_by_id(definition_cache_T* definition_cache, const char* id)
+{
+    if (id == (void*) 0)
+        return (void*) 0;
+
+    definition_cache_entry_T* entry = definition_cache->buckets_by_id[definition_cache_bucket(definition_cache, id)];
+
+    while (entry != (void*) 0 && entry->database_actor_definition->id != id)
+        entry = entry->next_by_id;
+
+    return entry;
+}
+
+static definition_cache_entry_T* definition_cache_find_by_name(definition_cache_T* definition_cache, const char* name)
+{
+    if (name == (void*) 0)
+        return (void*) 0;
+
+    definition_cache_entry_T* entry = definition_cache->buckets_by_name[definition_cache_bucket(definition_cache, name)];
+
+    while (entry != (void*) 0 && entry->database_actor_definition->name != name)
+        entry = entry->next_by_name;
+
+    return entry;
+}
+
+database_actor_definition_T* definition_cache_get_by_id(definition_cache_T* definition_cache, const char* id)
+{
+    pthread_mutex_lock(&definition_cache->lock);
+    database_actor_definition_T* database_actor_definition = definition_cache_hit(
+        definition_cache,
+        definition_cache_find_by_id(definition_cache, id)
+    );
+    pthread_mutex_unlock(&definition_cache->lock);
+
+    return database_actor_definition;
+}
+
+database_actor_definition_T* definition_cache_get_by_name(definition_cache_T* definition_cache, const char* name)
+{
+    pthread_mutex_lock(&definition_cache->lock);
+    database_actor_definition_T* database_actor_definition = definition_cache_hit(
+        definition_cache,
+        definition_cache_find_by_name(definition_cache, name)
+    );
+    pthread_mutex_unlock(&definition_cache->lock);
+
+    return database_actor_definition;
+}
+
+static void definition_cache_remove(definition_cache_T* definition_cache, definition_cache_entry_T* entry)
+{
+    database_actor_definition_T* database_actor_definition = entry->database_actor_definition;
+
+    definition_cache_entry_T** link = &definition_cache->buckets_by_id[
+        definition_cache_bucket(definition_cache, database_actor_definition->id)
+    ];
+
+    while (*link != entry)
+        link = &(*link)->next_by_id;
+
+    *link = entry->next_by_id;
+
+    link = &definition_cache->buckets_by_name[
+        definition_cache_bucket(definition_cache, database_actor_definition->name)
+    ];
+
+    while (*link != entry)
+        link = &(*link)->next_by_name;
+
+    *link = entry->next_by_name;
+
+    definition_cache_unlink(definition_cache, entry);
+    definition_cache->size -= 1;
+
+    database_actor_definition_free(database_actor_definition);
+    free(entry);
+}
+
+unsigned long definition_cache_generation(definition_cache_T* definition_cache)
+{
+    pthread_mutex_lock(&definition_cache->lock);
+    unsigned long generation = definition_cache->generation;
+    pthread_mutex_unlock(&definition_cache->lock);
+
+    return generation;
+}
+
+void definition_cache_get_stats(definition_cache_T* definition_cache, definition_cache_stats_T* stats)
+{
+    pthread_mutex_lock(&definition_cache->lock);
+    stats->size = definition_cache->size;
+    stats->hits = definition_cache->hits;
+    stats->misses = definition_cache->misses;
+    stats->evictions = definition_cache->evictions;
+    pthread_mutex_unlock(&definition_cache->lock);
+}
+
+void definition_cache_put(
+    definition_cache_T* definition_cache,
+    database_actor_definition_T* database_actor_definition,
+    unsigned long generation
+)
+{
+    if (definition_cache->capacity == 0)
+        return;
+
+    pthread_mutex_lock(&definition_cache->lock);
+
+    // invalidated while it was being read, it may be stale already
+    if (generation != definition_cache->generation)
+    {
+        pthread_mutex_unlock(&definition_cache->lock);
+        return;
+    }
+
+    definition_cache_entry_T* existing = definition_cache_find_by_id(definition_cache, database_actor_definition->id);
+
+    if (existing != (void*) 0)
+        definition_cache_remove(definition_cache, existing);
+
+    while (definition_cache->size >= definition_cache->capacity)
+    {
+        definition_cache_remove(definition_cache, definition_cache->least_recent);
+        definition_cache->evictions += 1;
+    }
+
+    definition_cache_entry_T* entry = calloc(1, sizeof(struct DEFINITION_CACHE_ENTRY_STRUCT));
+    entry->database_actor_definition = database_actor_definition;
+    database_actor_definition->references += 1;
+
+    size_t id_bucket = definition_cache_bucket(definition_cache, database_actor_definition->id);
+    entry->next_by_id = definition_cache->buckets_by_id[id_bucket];
+    definition_cache->buckets_by_id[id_bucket] = entry;
+
+    size_t name_bucket = definition_cache_bucket(definition_cache, database_actor_definition->name);
+    entry->next_by_name = definition_cache->buckets_by_name[name_bucket];
+    definition_cache->buckets_by_name[name_bucket] = entry;
+
+    definition_cache_push_front(definition_cache, entry);
+    definition_cache->size += 1;
+
+    pthread_mutex_unlock(&definition_cache->lock);
+}
+
+void definition_cache_remove_by_id(definition_cache_T* definition_cache, const char* id)
+{
+    pthread_mutex_lock(&definition_cache->lock);
+
+    definition_cache->generation += 1;
+
+    definition_cache_entry_T* entry = definition_cache_find_by_id(definition_cache, id);
+
+    if (entry != (void*) 0)
+        definition_cache_remove(definition_cache, entry);
+
+    pthread_mutex_unlock(&definition_cache->lock);
+}
+
+void definition_cache_remove_by_sprite_id(definition_cache_T* definition_cache, const char* sprite_id)
+{
+    if (sprite_id == (void*) 0)
+        return;
+
+    pthread_mutex_lock(&definition_cache->lock);
+
+    definition_cache->generation += 1;
+
+    definition_cache_entry_T* entry = definition_cache->most_recent;
+
+    while (entry != (void*) 0)
+    {
+        definition_cache_entry_T* next = entry->next;
+
+        if (entry->database_actor_definition->sprite_id == sprite_id)
+            definition_cache_remove(definition_cache, entry);
+
+        entry = next;
+    }
+
+    pthread_mutex_unlock(&definition_cache->lock);
+}
+
+void definition_cache_clear(definition_cache_T* definition_cache)
+{
+    pthread_mutex_lock(&definition_cache->lock);
+
+    definition_cache->generation += 1;
+
+    while (definition_cache->most_recent != (void*) 0)
+        definition_cache_remove(definition_cache, definition_cache->most_recent);
+
+    pthread_mutex_unlock(&definition_cache->lock);
+}
+
+void definition_cache_free(definition_cache_T* definition_cache)
+{
+    definition_cache_clear(definition_cache);
+
+    free(definition_cache->buckets_by_id);
+    free(definition_cache->buckets_by_name);
+    pthread_mutex_destroy(&definition_cache->lock);
+    free(definition_cache);
+}
@@ -4,32 +4,39 @@
 #include <coelum/sprite.h>
 #include <coelum/utils.h>
 #include <sqlite3.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "intern_table.h"
+#include "definition_cache.h"
+#include "database_writer.h"
+#include "database_mirror.h"
+#include "database_schema.h"
+#include "database_memory.h"
 
 char* get_random_string(unsigned int length);
 
 typedef struct DATABASE_SPRITE_STRUCT
 {
-    char* id;
-    char* name;
-    char* filepath;
+    DATABASE_SPRITES_COLUMNS(DATABASE_COLUMN_FIELD, database_sprite_T)
     sprite_T* sprite;
+    atomic_uint references;
 } database_sprite_T;
 
 database_sprite_T* init_database_sprite(char* id, char* name, char* filepath, sprite_T* sprite);
 
+/**
+ * Sprites loaded for a definition are shared with whoever got them from
+ * database_actor_definition_get_sprite; this releases one reference.
+ */
 void database_sprite_free(database_sprite_T* database_sprite);
 
-void database_sprite_reload_from_disk(database_sprite_T* database_sprite);
-
 typedef struct DATABASE_ACTOR_DEFINITION_STRUCT
 {
-    char* id;
-    char* name;
-    char* sprite_id;
-    char* init_script_id;
-    char* tick_script_id;
-    char* draw_script_id;
+    DATABASE_ACTOR_DEFINITIONS_COLUMNS(DATABASE_COLUMN_FIELD, database_actor_definition_T)
+    // NULL until database_actor_definition_get_sprite loads it
     database_sprite_T* database_sprite;
+    pthread_mutex_t sprite_lock;
+    atomic_uint references;
 
     // TODO: add friction
 } database_actor_definition_T;
@@ -44,24 +51,157 @@ database_actor_definition_T* init_database_actor_definition(
     database_sprite_T* database_sprite 
 );
 
+/**
+ * Definitions are reference counted and may be shared with the definition
+ * cache and other actor instances; this releases one reference.
+ */
 void database_actor_definition_free(database_actor_definition_T* database_actor_definition);
 
+/**
+ * Copy the on-disk database into a :memory: connection at startup.
+ * Every query is then served from memory; writes go to the file and are
+ * mirrored into the copy, see database_mirror.h.
+ */
+#define DATABASE_IN_MEMORY 1
+
+/**
+ * Keep the actor_instances of every scene in their own file under
+ * scenes/<scene_id>.db next to the main database, attached on demand.
+ */
+#define DATABASE_SHARD_SCENES 2
+
+/**
+ * Load scenes from a packed copy of their actor_instances: one BLOB of
+ * fixed width positions plus a definition index table, read in one go.
+ * A scene loaded from rows gets its pack queued on the writer without the
+ * load waiting for it, any change to its instances drops the pack until
+ * the next load.
+ */
+#define DATABASE_PACK_INSTANCES 4
+
+#define DATABASE_DEFINITION_CACHE_CAPACITY 256
+
+/**
+ * Sprites inserted asynchronously are encoded by at most this many worker
+ * threads, each spreading its frames over the shared frame pool.
+ */
+#define DATABASE_SPRITE_WRITE_THREADS 2
+
+/**
+ * Every database_* function may be called from any thread. Reads run on a
+ * read-only connection owned by the calling thread, writes are handed to the
+ * single writer thread and the call returns once they are committed.
+ */
 typedef struct DATABASE_STRUCT
 {
     const char* filename;
     sqlite3* db;
+    unsigned int flags;
+    // 0 when the asset search index could not be created
+    unsigned int searchable;
+    char* scenes_directory;
+    char* frames_directory;
+    char* atlases_directory;
+    intern_table_T* intern_table;
+    definition_cache_T* definition_cache;
+    char* memory_uri;
+    database_mirror_T* database_mirror;
+    database_writer_T* database_writer;
+    pthread_key_t reader_key;
+    pthread_mutex_t readers_lock;
+    struct DATABASE_READER_STRUCT* readers;
+    pthread_mutex_t sprite_writes_lock;
+    pthread_cond_t sprite_writes_done;
+    pthread_cond_t sprite_writes_queued;
+    unsigned int sprite_writes_pending;
+    struct DATABASE_SPRITE_WRITE_STRUCT* sprite_writes_head;
+    struct DATABASE_SPRITE_WRITE_STRUCT* sprite_writes_tail;
+    pthread_t sprite_write_threads[DATABASE_SPRITE_WRITE_THREADS];
+    unsigned int sprite_write_threads_size;
+    unsigned int sprite_writes_stopping;
+    struct DATABASE_FRAME_POOL_STRUCT* frame_pool;
 } database_T;
 
 database_T* init_database();
 
+database_T* init_database_with_flags(unsigned int flags);
+
+database_T* init_database_from_file(const char* filename, unsigned int flags);
+
+void database_free(database_T* database);
+
 sqlite3_stmt* database_exec_sql(database_T* database, char* sql, unsigned int do_error_checking);
 
+int database_exec_write(database_T* database, const char* scene_id, const char* sql);
+
+int database_submit_write(database_T* database, database_write_callback callback, void* user_data);
+
+void database_finalize(database_T* database, sqlite3_stmt* stmt);
+
+/**
+ * A read-only connection of its own, for reads that stay open across
+ * calls and must not hold the calling thread's snapshot. The caller closes
+ * it with sqlite3_close.
+ */
+sqlite3* database_open_reader(database_T* database);
+
+/**
+ * Ids and names of every entity loaded through the database are interned
+ * here. They are shared, owned by the database and released by database_free.
+ */
+char* database_intern(database_T* database, const char* string);
+
+/**
+ * Interns a text column, NULL for a NULL column.
+ */
+char* database_column_intern(database_T* database, sqlite3_stmt* stmt, int column);
+
+char* database_get_scene_schema(database_T* database, const char* scene_id);
+
+char* database_get_scene_filepath(database_T* database, const char* scene_id);
+
+sqlite3_stmt* database_exec_scene_sql(database_T* database, const char* scene_id, char* sql, unsigned int do_error_checking);
+
+void database_finalize_scene(database_T* database, const char* scene_id, sqlite3_stmt* stmt);
+
+/**
+ * Attaches the shard of scene_id to db under database_get_scene_schema(),
+ * doing nothing when it already is. Writable attaches create the shard,
+ * read only ones fail for a scene that has none.
+ */
+unsigned int database_attach_scene(database_T* database, sqlite3* db, const char* scene_id, unsigned int writable);
+
+void database_detach_scene(database_T* database, sqlite3* db, const char* scene_id);
+
+/**
+ * Opens the shard of scene_id as a writable connection of its own, created
+ * like a writable attach would. For writes that cannot detach the shard
+ * again inside their transaction. Closed with sqlite3_close.
+ */
+sqlite3* database_open_scene(database_T* database, const char* scene_id);
+
 char* database_insert_sprite(database_T* database, const char* name, sprite_T* sprite);
 
+typedef void (*database_sprite_inserted_callback)(const char* sprite_id, int rc, void* user_data);
+
+/**
+ * Returns the new sprite id right away and queues the sprite to be encoded
+ * and stored by one of the background workers, which calls callback once
+ * the sprite is committed (rc is SQLITE_OK) or failed.
+ * sprite must stay alive until the callback has run.
+ */
+char* database_insert_sprite_async(database_T* database, const char* name, sprite_T* sprite, database_sprite_inserted_callback callback, void* user_data);
+
 void database_update_sprite_name_by_id(database_T* database, const char* id, const char* name);
 
 database_sprite_T* database_get_sprite_by_id(database_T* database, const char* id);
 
+/**
+ * Loads the pixels of a sprite that was returned without them, or whose
+ * pixels were released.
+ */
+void database_sprite_reload(database_T* database, database_sprite_T* database_sprite);
+
 void database_delete_sprite_by_id(database_T* database, const char* id);
 
 char* database_insert_actor_definition(
@@ -77,6 +217,23 @@ database_actor_definition_T* database_get_actor_definition_by_id(database_T* dat
 
 database_actor_definition_T* database_get_actor_definition_by_name(database_T* database, const char* name);
 
+/**
+ * Definitions are returned without their sprite, it is loaded from disk
+ * the first time it is asked for here. Returns a new reference, released
+ * with database_sprite_free. NULL if there is no such sprite.
+ */
+database_sprite_T* database_actor_definition_get_sprite(
+    database_T* database,
+    database_actor_definition_T* database_actor_definition
+);
+
+/**
+ * Drops the definition's reference to its loaded sprite, the next get
+ * loads it again. Sprites returned earlier stay valid until their holders
+ * release them.
+ */
+void database_actor_definition_release_sprite(database_actor_definition_T* database_actor_definition);
+
 void database_update_actor_definition_by_id(
     database_T* database,
     const char* id,
@@ -91,11 +248,9 @@ void database_delete_actor_definition_by_id(database_T* database, const char* id
 
 typedef struct DATABASE_SCENE_STRUCT
 {
-    char* id;
-    char* name;
-    unsigned int main;
+    DATABASE_SCENES_COLUMNS(DATABASE_COLUMN_FIELD, database_scene_T)
 
-    // TODO: add bg_r, bg_g, bg_b and possibly tick_script and draw_script
+    // TODO: possibly add tick_script and draw_script
 } database_scene_T;
 
 database_scene_T* init_database_scene(char* id, char* name, unsigned int main);
@@ -108,6 +263,14 @@ unsigned int database_count_scenes(database_T* database);
 
 char* database_insert_scene(database_T* database, const char* name, unsigned int main);
 
+/**
+ * Copies the scene row and all of its actor instances inside SQLite, in
+ * one transaction and with fresh ids. A NULL name keeps the name, the
+ * copy is never the main scene.
+ * Returns the id of the copy, NULL if there is no such scene.
+ */
+char* database_duplicate_scene(database_T* database, const char* scene_id, const char* name);
+
 void database_delete_scene_by_id(database_T* database, const char* id);
 
 void database_update_scene_by_id(database_T* database, const char* id, const char* name, unsigned int main);
@@ -118,15 +281,8 @@ void database_unset_main_flag_on_all_scenes(database_T* database);
 
 typedef struct DATABASE_ACTOR_INSTANCE_STRUCT
 {
-    char* id;
-    char* actor_definition_id;
-    char* scene_id;
-    float x;
-    float y;
-    float z;
+    DATABASE_ACTOR_INSTANCES_COLUMNS(DATABASE_COLUMN_FIELD, database_actor_instance_T)
     database_actor_definition_T* database_actor_definition;
-
-    //TODO: add rx, ry, rz
 } database_actor_instance_T;
 
 database_actor_instance_T* init_database_actor_instance(
@@ -150,6 +306,14 @@ char* database_insert_actor_instance(
     const float z
 );
 
+sqlite3_stmt* database_prepare_actor_instances_by_scene_id(database_T* database, const char* scene_id);
+
+/**
+ * The instance whose actor_instances columns start at first_column of the
+ * row stmt is on.
+ */
+database_actor_instance_T* database_actor_instance_from_row(database_T* database, sqlite3_stmt* stmt, int first_column);
+
 dynamic_list_T* database_get_all_actor_instances_by_scene_id(database_T* database, const char* scene_id);
 
 void database_delete_actor_instance_by_id(database_T* database, const char* id);
@@ -163,9 +327,7 @@ unsigned int database_count_actors_in_scene(database_T* database, const char* sc
 
 typedef struct DATABASE_SCRIPT_STRUCT
 {
-    char* id;
-    char* name;
-    char* filepath;
+    DATABASE_SCRIPTS_COLUMNS(DATABASE_COLUMN_FIELD, database_script_T)
     char* contents;
 } database_script_T;
 
@@ -173,6 +335,12 @@ database_script_T* init_database_script(char* id, char* name, char* filepath, ch
 
 void database_script_free(database_script_T* database_script);
 
+/**
+ * Sets the script body, which the script does not own. Use this rather
+ * than assigning contents so the body is accounted for.
+ */
+void database_script_set_contents(database_script_T* database_script, char* contents);
+
 char* database_insert_script(
     database_T* database,
     const char* name,
@@ -0,0 +1,44 @@
+#ifndef ATHENA_DATABASE_ATLAS_H
+#define ATHENA_DATABASE_ATLAS_H
+#include "database.h"
+
+#define DATABASE_ATLAS_SIZE 2048
+
+typedef struct DATABASE_ATLAS_FRAME_STRUCT
+{
+    char* atlas_id;
+    char* filepath;
+    int x;
+    int y;
+    int width;
+    int height;
+    float u0;
+    float v0;
+    float u1;
+    float v1;
+} database_atlas_frame_T;
+
+void database_atlas_frame_free(database_atlas_frame_T* database_atlas_frame);
+
+/**
+ * Packs every frame of every sprite used by the scene into as few
+ * atlas_size x atlas_size atlases as possible, writes them as
+ * <atlas_id>.spr to the database's atlases_directory and records where
+ * each frame ended up.
+ * Atlases previously built for the scene are replaced.
+ *
+ * Returns the number of atlases written.
+ */
+unsigned int database_build_scene_atlases(database_T* database, const char* scene_id, unsigned int atlas_size);
+
+/**
+ * Returns the atlas and rectangle holding a frame of a sprite in a scene,
+ * or NULL when no atlas has been built for it.
+ */
+database_atlas_frame_T* database_get_atlas_frame(
+    database_T* database,
+    const char* scene_id,
+    const char* sprite_id,
+    unsigned int frame
+);
+#endif
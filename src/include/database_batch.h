@@ -0,0 +1,20 @@
+#ifndef ATHENA_DATABASE_BATCH_H
+#define ATHENA_DATABASE_BATCH_H
+#include "database.h"
+
+/**
+ * Ids are bound this many at a time, well below SQLite's variable limit.
+ */
+#define DATABASE_BATCH_SIZE 400
+
+/**
+ * Batch lookups by id. The returned list has one item per id, in the order
+ * the ids were given, and NULL where no row has that id. Items are freed
+ * by the caller like the ones returned by the single id lookups.
+ */
+dynamic_list_T* database_get_sprites_by_ids(database_T* database, const char** ids, size_t ids_size);
+
+dynamic_list_T* database_get_scripts_by_ids(database_T* database, const char** ids, size_t ids_size);
+
+dynamic_list_T* database_get_actor_definitions_by_ids(database_T* database, const char** ids, size_t ids_size);
+#endif
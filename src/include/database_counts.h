@@ -0,0 +1,27 @@
+#ifndef ATHENA_DATABASE_COUNTS_H
+#define ATHENA_DATABASE_COUNTS_H
+#include "database.h"
+
+typedef struct DATABASE_COUNT_STRUCT
+{
+    char* id;
+    unsigned int count;
+} database_count_T;
+
+database_count_T* init_database_count(char* id, unsigned int count);
+
+void database_count_free(database_count_T* database_count);
+
+/**
+ * Actor instance counts for every scene, actor definition or sprite, in
+ * one grouped query instead of one count per entity. Every entity is
+ * listed, also those without actors, ordered by id; rows without an id
+ * are left out.
+ * With DATABASE_SHARD_SCENES the grouped query runs once per scene file.
+ */
+dynamic_list_T* database_count_actors_per_scene(database_T* database);
+
+dynamic_list_T* database_count_actors_per_actor_definition(database_T* database);
+
+dynamic_list_T* database_count_actors_per_sprite(database_T* database);
+#endif
@@ -0,0 +1,71 @@
+#ifndef ATHENA_DATABASE_FRAMES_H
+#define ATHENA_DATABASE_FRAMES_H
+#include "database.h"
+#include <coelum/textures.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#define DATABASE_FRAME_ENCODE_THREADS 8
+
+/**
+ * Threads shared by every sprite being encoded, each frame is taken by
+ * whichever thread is free, up to one per core.
+ */
+typedef struct DATABASE_FRAME_POOL_STRUCT
+{
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_cond_t done;
+    struct DATABASE_FRAME_ENCODER_STRUCT* encoders;
+    pthread_t threads[DATABASE_FRAME_ENCODE_THREADS];
+    unsigned int threads_size;
+    unsigned int started;
+    unsigned int stopping;
+} database_frame_pool_T;
+
+database_frame_pool_T* init_database_frame_pool();
+
+void database_frame_pool_free(database_frame_pool_T* pool);
+
+/**
+ * Frames are stored once per distinct pixel content as <hash>.spr in the
+ * database's frames_directory, sprites only reference them by hash.
+ */
+uint64_t database_frame_hash(texture_T* texture);
+
+/**
+ * Hashes every frame into hashes and writes the files of frames not on
+ * disk yet, spread over the threads of the database's frame pool.
+ * Needs no connection, run it before handing the frames to the writer.
+ */
+void database_encode_sprite_frames(database_T* database, dynamic_list_T* textures, uint64_t* hashes);
+
+/**
+ * Stores the frames of sprite_id, writing frame files that do not exist
+ * yet and bumping the reference count of those that do.
+ * Must run on the writer connection inside a transaction.
+ */
+int database_store_sprite_frames(sqlite3* db, const char* directory, const char* sprite_id, dynamic_list_T* textures, uint64_t* hashes);
+
+/**
+ * Deletes the frame files written for a sprite whose insert rolled back,
+ * leaving those a committed frames row refers to.
+ * Must run on the writer connection after the rollback.
+ */
+void database_discard_sprite_frames(sqlite3* db, const char* directory, dynamic_list_T* textures, uint64_t* hashes);
+
+/**
+ * Drops the references sprite_id holds, frames nobody references anymore
+ * are removed and their files appended to released_filepaths.
+ * Must run on the writer connection inside a transaction, the files are
+ * only to be deleted once it committed.
+ */
+int database_release_sprite_frames(sqlite3* db, const char* sprite_id, dynamic_list_T* released_filepaths);
+
+/**
+ * Frees a list of frame files, deleting them from disk first if delete.
+ */
+void database_delete_frame_files(dynamic_list_T* filepaths, unsigned int delete);
+
+sprite_T* database_load_sprite_frames(database_T* database, const char* sprite_id);
+#endif
@@ -0,0 +1,36 @@
+#ifndef ATHENA_DATABASE_MEMORY_H
+#define ATHENA_DATABASE_MEMORY_H
+#include <stddef.h>
+
+#define DATABASE_MEMORY_STRINGS 0
+#define DATABASE_MEMORY_ENTITIES 1
+#define DATABASE_MEMORY_SPRITE_PIXELS 2
+#define DATABASE_MEMORY_SCRIPTS 3
+#define DATABASE_MEMORY_CATEGORIES 4
+
+/**
+ * Process wide accounting of what loaded entities keep in memory:
+ * interned strings and owned filepaths, entity structs, sprite pixel data
+ * and script bodies. Allocations counts every allocation ever made, live
+ * those not freed yet.
+ */
+typedef struct DATABASE_MEMORY_STATS_STRUCT
+{
+    size_t current_bytes;
+    size_t peak_bytes;
+    size_t allocations;
+    size_t live;
+} database_memory_stats_T;
+
+void database_memory_track_alloc(int category, size_t bytes);
+
+void database_memory_track_free(int category, size_t bytes);
+
+/**
+ * Fills stats, which must hold DATABASE_MEMORY_CATEGORIES entries, indexed
+ * by category.
+ */
+void database_get_memory_stats(database_memory_stats_T* stats);
+
+const char* database_memory_category_name(int category);
+#endif
@@ -0,0 +1,45 @@
+#ifndef ATHENA_DATABASE_MIRROR_H
+#define ATHENA_DATABASE_MIRROR_H
+#include <sqlite3.h>
+#include <stddef.h>
+
+typedef struct DATABASE_MIRROR_TABLE_STRUCT
+{
+    sqlite3_stmt* insert_stmt;
+    sqlite3_stmt* update_stmt;
+    sqlite3_stmt* delete_stmt;
+} database_mirror_table_T;
+
+/**
+ * Replays every row written through one connection into a copy of the
+ * same database held by another, for DATABASE_IN_MEMORY: writes go to the
+ * file and readers keep reading the copy.
+ *
+ * Temporary triggers on the tables of the source hand each inserted,
+ * updated and deleted row to the copy, addressed by rowid, and the copy's
+ * transaction commits and rolls back with the source's. Tables the
+ * triggers insert into, and virtual tables, are kept up to date by the
+ * copy's own triggers. The copy must start out identical to the source, as
+ * a backup of it, and the schema must not change while mirrored.
+ * A statement failing half way in a transaction that still commits keeps
+ * its earlier rows in the copy, and so does a ROLLBACK TO a savepoint.
+ */
+typedef struct DATABASE_MIRROR_STRUCT
+{
+    sqlite3* db;
+    database_mirror_table_T* tables;
+    size_t tables_size;
+} database_mirror_T;
+
+/**
+ * Mirrors what is written through db into copy_db, which the mirror owns
+ * and closes. Returns NULL when the triggers cannot be set up.
+ * Only the thread writing through db may use it.
+ */
+database_mirror_T* init_database_mirror(sqlite3* db, sqlite3* copy_db);
+
+/**
+ * Frees the mirror, after db was closed.
+ */
+void database_mirror_free(database_mirror_T* database_mirror);
+#endif
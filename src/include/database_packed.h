@@ -0,0 +1,72 @@
+#ifndef ATHENA_DATABASE_PACKED_H
+#define ATHENA_DATABASE_PACKED_H
+#include "database.h"
+#include <stdint.h>
+
+/**
+ * Bumped whenever database_packed_instance_T changes, packs written with
+ * another layout are ignored and rebuilt.
+ */
+#define DATABASE_PACKED_VERSION 2
+
+/**
+ * One actor instance of a packed scene, definition indexes the scene's
+ * actor_definition_ids.
+ */
+typedef struct DATABASE_PACKED_INSTANCE_STRUCT
+{
+    uint32_t definition;
+    float x;
+    float y;
+    float z;
+    float rx;
+    float ry;
+    float rz;
+} database_packed_instance_T;
+
+/**
+ * A scene's instances as stored in packed_scenes: the transforms as one
+ * contiguous array, ids[i] is the id of instances[i]. Ids are interned.
+ */
+typedef struct DATABASE_PACKED_SCENE_STRUCT
+{
+    char* scene_id;
+    char** actor_definition_ids;
+    size_t actor_definition_ids_size;
+    char** ids;
+    database_packed_instance_T* instances;
+    size_t instances_size;
+} database_packed_scene_T;
+
+void database_packed_scene_free(database_packed_scene_T* database_packed_scene);
+
+/**
+ * Creates packed_scenes in schema, with triggers dropping a scene's pack
+ * as soon as one of its actor_instances rows changes.
+ */
+char* database_packed_create_sql(const char* schema);
+
+/**
+ * Builds the pack of scene_id from its actor_instances rows on the writer.
+ */
+int database_pack_scene(database_T* database, const char* scene_id);
+
+/**
+ * Like database_pack_scene but returns right away, the writer builds the
+ * pack after the writes already queued. Scenes packed meanwhile are left
+ * as they are.
+ */
+void database_queue_scene_pack(database_T* database, const char* scene_id);
+
+/**
+ * The pack of scene_id in a single read, NULL when the scene has none
+ * (never packed, or changed since).
+ */
+database_packed_scene_T* database_load_packed_scene(database_T* database, const char* scene_id);
+
+/**
+ * Actor instances as database_get_all_actor_instances_by_scene_id returns
+ * them, built from a pack instead of one row each.
+ */
+dynamic_list_T* database_packed_scene_get_actor_instances(database_T* database, database_packed_scene_T* database_packed_scene);
+#endif
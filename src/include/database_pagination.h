@@ -0,0 +1,41 @@
+#ifndef ATHENA_DATABASE_PAGINATION_H
+#define ATHENA_DATABASE_PAGINATION_H
+#include "database.h"
+
+/**
+ * Keyset pagination over the asset tables, ordered by name, a NULL name
+ * sorting as the empty one.
+ *
+ * Pass a NULL continuation_token for the first page. When more rows are
+ * available *next_token receives a newly allocated token to pass to the
+ * next call, otherwise it is set to NULL. Sprites, scripts and actor
+ * definitions are returned without their sprite or script contents loaded.
+ */
+dynamic_list_T* database_get_scenes_page(
+    database_T* database,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token
+);
+
+dynamic_list_T* database_get_sprites_page(
+    database_T* database,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token
+);
+
+dynamic_list_T* database_get_scripts_page(
+    database_T* database,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token
+);
+
+dynamic_list_T* database_get_actor_definitions_page(
+    database_T* database,
+    const char* continuation_token,
+    unsigned int page_size,
+    char** next_token
+);
+#endif
@@ -0,0 +1,54 @@
+#ifndef ATHENA_DATABASE_QUERY_H
+#define ATHENA_DATABASE_QUERY_H
+#include "database.h"
+#include <time.h>
+
+#define DATABASE_QUERY_PENDING 0
+#define DATABASE_QUERY_DONE 1
+#define DATABASE_QUERY_CANCELLED 2
+#define DATABASE_QUERY_ERROR 3
+
+/**
+ * A query that is stepped a little at a time, so the editor can stream a
+ * large scene in over several frames. Rows are appended to results as they
+ * are read. Every query reads through a connection of its own, opened by
+ * begin and closed by free. It may be stepped by any one thread at a time,
+ * but only the thread that began it may cancel and free it, so a cancel
+ * interrupting the connection never races free closing it.
+ */
+typedef struct DATABASE_QUERY_STRUCT
+{
+    database_T* database;
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+    char* scene_id;
+    dynamic_list_T* results;
+    int status;
+    pthread_t owner;
+    long long deadline;
+    sqlite3_int64 last_rowid;
+    atomic_int cancelled;
+    atomic_int stepping;
+} database_query_T;
+
+database_query_T* database_begin_get_all_actor_instances_by_scene_id(database_T* database, const char* scene_id);
+
+/**
+ * Reads rows for at most budget_us microseconds, give or take the time
+ * SQLite takes between two progress checks, and returns the status of the
+ * query. Call again on the next frame while it is DATABASE_QUERY_PENDING.
+ */
+int database_query_step(database_query_T* database_query, unsigned int budget_us);
+
+/**
+ * Stops the query, interrupting a step running on another thread. Only
+ * from the thread that began the query.
+ */
+void database_query_cancel(database_query_T* database_query);
+
+/**
+ * Frees the query. Results already handed out through results are owned by
+ * the caller and are not freed.
+ */
+void database_query_free(database_query_T* database_query);
+#endif
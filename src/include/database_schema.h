@@ -0,0 +1,147 @@
+#ifndef ATHENA_DATABASE_SCHEMA_H
+#define ATHENA_DATABASE_SCHEMA_H
+#include <sqlite3.h>
+#include <stddef.h>
+#include "intern_table.h"
+
+/**
+ * How a column is stored in its struct field:
+ * ID and TEXT are interned char*, OPTIONAL_TEXT is an interned char* that
+ * is NULL for an empty column, PATH is a char* owned by the struct,
+ * INT is an int or unsigned int and FLOAT is a float.
+ */
+#define DATABASE_COLUMN_ID 0
+#define DATABASE_COLUMN_TEXT 1
+#define DATABASE_COLUMN_OPTIONAL_TEXT 2
+#define DATABASE_COLUMN_PATH 3
+#define DATABASE_COLUMN_INT 4
+#define DATABASE_COLUMN_FLOAT 5
+
+/**
+ * The columns of every entity table, in table order:
+ * COLUMN(row_type, field, c_type, sql_type, kind)
+ *
+ * The entity structs, their CREATE TABLE statements and all the SQL and
+ * code that moves them in and out of the database are generated from
+ * these lists, so a column is added by adding a line here.
+ */
+#define DATABASE_SPRITES_COLUMNS(COLUMN, row_type) \
+    COLUMN(row_type, id, char*, TEXT, DATABASE_COLUMN_ID) \
+    COLUMN(row_type, name, char*, TEXT, DATABASE_COLUMN_TEXT) \
+    COLUMN(row_type, filepath, char*, TEXT, DATABASE_COLUMN_PATH) \
+    COLUMN(row_type, width, int, INT, DATABASE_COLUMN_INT) \
+    COLUMN(row_type, height, int, INT, DATABASE_COLUMN_INT) \
+    COLUMN(row_type, frame_delay, float, FLOAT, DATABASE_COLUMN_FLOAT) \
+    COLUMN(row_type, animate, unsigned int, INT, DATABASE_COLUMN_INT)
+
+#define DATABASE_ACTOR_DEFINITIONS_COLUMNS(COLUMN, row_type) \
+    COLUMN(row_type, id, char*, TEXT, DATABASE_COLUMN_ID) \
+    COLUMN(row_type, name, char*, TEXT, DATABASE_COLUMN_TEXT) \
+    COLUMN(row_type, init_script_id, char*, TEXT, DATABASE_COLUMN_OPTIONAL_TEXT) \
+    COLUMN(row_type, tick_script_id, char*, TEXT, DATABASE_COLUMN_OPTIONAL_TEXT) \
+    COLUMN(row_type, draw_script_id, char*, TEXT, DATABASE_COLUMN_OPTIONAL_TEXT) \
+    COLUMN(row_type, sprite_id, char*, TEXT, DATABASE_COLUMN_TEXT)
+
+#define DATABASE_SCENES_COLUMNS(COLUMN, row_type) \
+    COLUMN(row_type, id, char*, TEXT, DATABASE_COLUMN_ID) \
+    COLUMN(row_type, name, char*, TEXT, DATABASE_COLUMN_TEXT) \
+    COLUMN(row_type, bg_r, int, INT, DATABASE_COLUMN_INT) \
+    COLUMN(row_type, bg_g, int, INT, DATABASE_COLUMN_INT) \
+    COLUMN(row_type, bg_b, int, INT, DATABASE_COLUMN_INT) \
+    COLUMN(row_type, main, unsigned int, INT, DATABASE_COLUMN_INT)
+
+#define DATABASE_ACTOR_INSTANCES_COLUMNS(COLUMN, row_type) \
+    COLUMN(row_type, id, char*, TEXT, DATABASE_COLUMN_ID) \
+    COLUMN(row_type, actor_definition_id, char*, TEXT, DATABASE_COLUMN_TEXT) \
+    COLUMN(row_type, x, float, FLOAT, DATABASE_COLUMN_FLOAT) \
+    COLUMN(row_type, y, float, FLOAT, DATABASE_COLUMN_FLOAT) \
+    COLUMN(row_type, z, float, FLOAT, DATABASE_COLUMN_FLOAT) \
+    COLUMN(row_type, scene_id, char*, TEXT, DATABASE_COLUMN_TEXT) \
+    COLUMN(row_type, rx, float, FLOAT, DATABASE_COLUMN_FLOAT) \
+    COLUMN(row_type, ry, float, FLOAT, DATABASE_COLUMN_FLOAT) \
+    COLUMN(row_type, rz, float, FLOAT, DATABASE_COLUMN_FLOAT)
+
+#define DATABASE_SCRIPTS_COLUMNS(COLUMN, row_type) \
+    COLUMN(row_type, id, char*, TEXT, DATABASE_COLUMN_ID) \
+    COLUMN(row_type, name, char*, TEXT, DATABASE_COLUMN_TEXT) \
+    COLUMN(row_type, filepath, char*, TEXT, DATABASE_COLUMN_PATH)
+
+#define DATABASE_COLUMN_FIELD(row_type, field, c_type, sql_type, kind) c_type field;
+
+#define DATABASE_COLUMN_DESCRIPTOR(row_type, field, c_type, sql_type, kind) \
+    { #field, #sql_type, kind, offsetof(row_type, field) },
+
+typedef struct DATABASE_COLUMN_STRUCT
+{
+    const char* name;
+    const char* sql_type;
+    int kind;
+    size_t offset;
+} database_column_T;
+
+typedef struct DATABASE_TABLE_STRUCT
+{
+    const char* name;
+    const database_column_T* columns;
+    size_t columns_size;
+} database_table_T;
+
+extern const database_table_T database_sprites_table;
+extern const database_table_T database_actor_definitions_table;
+extern const database_table_T database_scenes_table;
+extern const database_table_T database_actor_instances_table;
+extern const database_table_T database_scripts_table;
+
+/**
+ * The generated statements take the schema to qualify the table with, or
+ * NULL. Statements with parameters bind column i of a row to ?<i + 1>, so
+ * one database_table_bind works for all of them.
+ */
+char* database_table_create_sql(const database_table_T* table, const char* schema);
+
+/**
+ * Adds the columns of table that an existing table, created by an older
+ * version, is missing. err_msg is set like sqlite3_exec sets it.
+ */
+int database_table_migrate(sqlite3* db, const database_table_T* table, const char* schema, char** err_msg);
+
+/**
+ * "SELECT <columns> FROM <table> <clause>", prefix is selected before the
+ * columns when not NULL, e.g. "rowid".
+ */
+char* database_table_select_sql(const database_table_T* table, const char* schema, const char* prefix, const char* clause);
+
+char* database_table_insert_sql(const database_table_T* table, const char* schema);
+
+/**
+ * Updates every column of the row whose id is ?1.
+ */
+char* database_table_update_sql(const database_table_T* table, const char* schema);
+
+/**
+ * INSERT INTO schema.table(...) SELECT ... FROM from_schema.table clause,
+ * copying every column except those with a replacement expression, which
+ * is selected in its place. replacements holds one entry per column.
+ */
+char* database_table_copy_sql(
+    const database_table_T* table,
+    const char* schema,
+    const char* from_schema,
+    const char** replacements,
+    const char* clause
+);
+
+void database_table_bind(sqlite3_stmt* stmt, const database_table_T* table, const void* row);
+
+/**
+ * Reads the columns starting at first_column into row, text columns are
+ * interned into intern_table or copied as their kind says.
+ */
+void database_table_read(
+    sqlite3_stmt* stmt,
+    const database_table_T* table,
+    intern_table_T* intern_table,
+    int first_column,
+    void* row
+);
+#endif
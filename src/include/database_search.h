@@ -0,0 +1,40 @@
+#ifndef ATHENA_DATABASE_SEARCH_H
+#define ATHENA_DATABASE_SEARCH_H
+#include "database.h"
+
+#define DATABASE_ASSET_SPRITE 1
+#define DATABASE_ASSET_SCRIPT 2
+#define DATABASE_ASSET_ACTOR_DEFINITION 4
+#define DATABASE_ASSET_SCENE 8
+#define DATABASE_ASSET_ALL 15
+
+typedef struct DATABASE_ASSET_STRUCT
+{
+    int kind;
+    char* id;
+    char* name;
+} database_asset_T;
+
+database_asset_T* init_database_asset(int kind, char* id, char* name);
+
+void database_asset_free(database_asset_T* database_asset);
+
+/**
+ * Creates the asset_names full text index and the triggers keeping it in
+ * sync with the sprites, scripts, actor_definitions and scenes tables,
+ * indexing existing rows the first time. Assets are keyed on their id and
+ * kind. When it fails, e.g. for an SQLite without FTS5 or the trigram
+ * tokenizer, the triggers are dropped so writes keep working.
+ */
+int database_search_create_schema(sqlite3* db);
+
+/**
+ * Assets of the given kinds (DATABASE_ASSET_* bits) whose name contains
+ * every word of query, names starting with query first. When that finds
+ * fewer than limit assets the rest is filled up with names sharing the
+ * most trigrams with query, which tolerates typos.
+ * Returns a list of database_asset_T, id and name are interned, empty if
+ * the index could not be created.
+ */
+dynamic_list_T* database_search_assets(database_T* database, const char* query, int kinds, int limit);
+#endif
@@ -0,0 +1,38 @@
+#ifndef ATHENA_DATABASE_THUMBNAILS_H
+#define ATHENA_DATABASE_THUMBNAILS_H
+#include "database.h"
+#include <coelum/textures.h>
+
+/**
+ * Thumbnails fit in a square this many pixels wide, keeping the aspect
+ * ratio. Smaller frames are stored as they are.
+ */
+#define DATABASE_THUMBNAIL_SIZE 64
+
+/**
+ * A downscaled copy of a sprite's first frame, RGBA like texture data.
+ */
+typedef struct DATABASE_THUMBNAIL_STRUCT
+{
+    int width;
+    int height;
+    unsigned char* pixels;
+} database_thumbnail_T;
+
+database_thumbnail_T* init_database_thumbnail_from_texture(texture_T* texture);
+
+void database_thumbnail_free(database_thumbnail_T* database_thumbnail);
+
+/**
+ * Stores the thumbnail of sprite_id.
+ * Must run on the writer connection.
+ */
+int database_store_sprite_thumbnail(sqlite3* db, const char* sprite_id, database_thumbnail_T* database_thumbnail);
+
+/**
+ * The stored thumbnail of sprite_id, a single row read. Sprites inserted
+ * before thumbnails existed get theirs made from the first frame alone
+ * the first time they are asked for. NULL if there is no such sprite.
+ */
+database_thumbnail_T* database_get_sprite_thumbnail(database_T* database, const char* sprite_id);
+#endif
@@ -0,0 +1,34 @@
+#ifndef ATHENA_DATABASE_TRANSFER_H
+#define ATHENA_DATABASE_TRANSFER_H
+#include "database.h"
+#include <stdio.h>
+
+/**
+ * Scenes travel as JSON Lines, one flat object per row:
+ * {"type":"<table>","<column>":<value>,...}
+ * with the columns of database_schema.h. Each scene is written as its
+ * scene row, the actor definitions its instances use that were not
+ * written yet, and then its actor instances.
+ */
+#define DATABASE_TRANSFER_MAX_FIELDS 32
+
+/**
+ * Streams the given scenes into file row by row, only the definitions
+ * written so far are kept in memory.
+ */
+int database_export_scenes(database_T* database, const char** scene_ids, size_t scene_ids_size, FILE* file);
+
+/**
+ * Reads rows written by database_export_scenes (or any tool producing the
+ * same lines) one line at a time and inserts them in a single
+ * transaction on the writer, nothing is kept if a line fails.
+ * Ids are kept. Scenes and definitions that already exist are skipped,
+ * as are the instances of a skipped scene.
+ * With DATABASE_SHARD_SCENES every scene file the input writes to is open
+ * through a connection of its own, each in a transaction kept open until
+ * the end: they are committed before main, or all rolled back, and files
+ * the import created are removed again. Only a COMMIT failing on one of
+ * them leaves the scene files committed before it.
+ */
+int database_import_scenes(database_T* database, FILE* file);
+#endif
@@ -0,0 +1,50 @@
+#ifndef ATHENA_DATABASE_WRITER_H
+#define ATHENA_DATABASE_WRITER_H
+#include <sqlite3.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+typedef int (*database_write_callback)(sqlite3* db, void* user_data);
+
+typedef struct DATABASE_WRITE_STRUCT
+{
+    struct DATABASE_WRITE_STRUCT* _Atomic next;
+    database_write_callback callback;
+    void* user_data;
+    int rc;
+    // posted writes nobody waits for, freed by the writer once they ran
+    unsigned int detached;
+    sem_t done;
+} database_write_T;
+
+/**
+ * Owns the only writable connection and runs every write on its own thread.
+ *
+ * Writes are pushed onto an intrusive lock-free multi-producer /
+ * single-consumer queue, so any number of threads can submit while the
+ * writer drains them in order.
+ */
+typedef struct DATABASE_WRITER_STRUCT
+{
+    sqlite3* db;
+    pthread_t thread;
+    database_write_T* _Atomic head;
+    database_write_T* tail;
+    database_write_T stub;
+    sem_t pending;
+} database_writer_T;
+
+database_writer_T* init_database_writer(sqlite3* db);
+
+int database_writer_submit(database_writer_T* database_writer, database_write_callback callback, void* user_data);
+
+/**
+ * Queues a write and returns right away, user_data must stay alive until
+ * the callback ran. Posted writes still run before database_writer_free
+ * returns.
+ */
+void database_writer_post(database_writer_T* database_writer, database_write_callback callback, void* user_data);
+
+void database_writer_free(database_writer_T* database_writer);
+#endif
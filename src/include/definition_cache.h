@@ -0,0 +1,85 @@
+#ifndef ATHENA_DEFINITION_CACHE_H
+#define ATHENA_DEFINITION_CACHE_H
+#include <stddef.h>
+#include <pthread.h>
+
+struct DATABASE_ACTOR_DEFINITION_STRUCT;
+
+typedef struct DEFINITION_CACHE_ENTRY_STRUCT
+{
+    struct DATABASE_ACTOR_DEFINITION_STRUCT* database_actor_definition;
+    struct DEFINITION_CACHE_ENTRY_STRUCT* prev;
+    struct DEFINITION_CACHE_ENTRY_STRUCT* next;
+    struct DEFINITION_CACHE_ENTRY_STRUCT* next_by_id;
+    struct DEFINITION_CACHE_ENTRY_STRUCT* next_by_name;
+} definition_cache_entry_T;
+
+/**
+ * Bounded LRU cache of actor definitions, indexed by id and by name.
+ *
+ * Keys are interned strings and are compared by pointer. The cache holds a
+ * reference to every definition it stores; lookups return a new reference
+ * which the caller releases with database_actor_definition_free.
+ *
+ * Every invalidation bumps generation. A definition read from the database
+ * is only put if no invalidation happened since the read started, so a
+ * row selected just before an update or delete is never cached.
+ */
+typedef struct DEFINITION_CACHE_STRUCT
+{
+    definition_cache_entry_T** buckets_by_id;
+    definition_cache_entry_T** buckets_by_name;
+    size_t bucket_count;
+    definition_cache_entry_T* most_recent;
+    definition_cache_entry_T* least_recent;
+    size_t size;
+    size_t capacity;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long generation;
+    pthread_mutex_t lock;
+} definition_cache_T;
+
+/**
+ * A consistent copy of the counters, taken under the cache's lock.
+ */
+typedef struct DEFINITION_CACHE_STATS_STRUCT
+{
+    size_t size;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} definition_cache_stats_T;
+
+definition_cache_T* init_definition_cache(size_t capacity);
+
+struct DATABASE_ACTOR_DEFINITION_STRUCT* definition_cache_get_by_id(definition_cache_T* definition_cache, const char* id);
+
+struct DATABASE_ACTOR_DEFINITION_STRUCT* definition_cache_get_by_name(definition_cache_T* definition_cache, const char* name);
+
+/**
+ * Take this before reading a definition from the database and hand it to
+ * definition_cache_put with the result.
+ */
+unsigned long definition_cache_generation(definition_cache_T* definition_cache);
+
+/**
+ * hits, misses and evictions change under the lock, read them through this.
+ */
+void definition_cache_get_stats(definition_cache_T* definition_cache, definition_cache_stats_T* stats);
+
+void definition_cache_put(
+    definition_cache_T* definition_cache,
+    struct DATABASE_ACTOR_DEFINITION_STRUCT* database_actor_definition,
+    unsigned long generation
+);
+
+void definition_cache_remove_by_id(definition_cache_T* definition_cache, const char* id);
+
+void definition_cache_remove_by_sprite_id(definition_cache_T* definition_cache, const char* sprite_id);
+
+void definition_cache_clear(definition_cache_T* definition_cache);
+
+void definition_cache_free(definition_cache_T* definition_cache);
+#endif
@@ -0,0 +1,29 @@
+#ifndef ATHENA_INTERN_TABLE_H
+#define ATHENA_INTERN_TABLE_H
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * Stores each distinct string once. Returned pointers stay valid until the
+ * table is freed, so two interned strings are equal only if their pointers are.
+ * Interned strings must not be modified or freed by the caller. The table
+ * may be used from several threads at once.
+ */
+typedef struct INTERN_TABLE_STRUCT
+{
+    char** strings;
+    size_t capacity;
+    size_t size;
+    pthread_mutex_t lock;
+} intern_table_T;
+
+intern_table_T* init_intern_table();
+
+char* intern_table_intern(intern_table_T* intern_table, const char* string);
+
+char* intern_table_intern_n(intern_table_T* intern_table, const char* string, size_t length);
+
+char* intern_table_find(intern_table_T* intern_table, const char* string);
+
+void intern_table_free(intern_table_T* intern_table);
+#endif
@@ -0,0 +1,64 @@
+#ifndef ATHENA_RESIDENCY_MANAGER_H
+#define ATHENA_RESIDENCY_MANAGER_H
+#include "database.h"
+
+typedef struct RESIDENT_SCENE_STRUCT
+{
+    database_scene_T* database_scene;
+    dynamic_list_T* database_actor_instances;
+    size_t bytes;
+    unsigned long last_used;
+} resident_scene_T;
+
+typedef struct RESIDENT_SPRITE_STRUCT
+{
+    database_actor_definition_T* database_actor_definition;
+    // the manager's own reference, NULL while not resident
+    database_sprite_T* database_sprite;
+    size_t bytes;
+    unsigned long last_used;
+    unsigned int scene_references;
+} resident_sprite_T;
+
+/**
+ * Keeps recently used scenes and the sprites of their actor definitions
+ * loaded while the total stays within budget bytes.
+ *
+ * When over budget, the least recently used sprite pixel data is released
+ * first and scenes are only evicted once no sprite is left to release.
+ * Evicted sprites are reloaded by residency_manager_get_sprite, so sprite_T
+ * pointers should not be kept across calls into the manager. Eviction only
+ * drops the references the manager and the definition hold, sprites taken
+ * with database_actor_definition_get_sprite stay valid.
+ */
+typedef struct RESIDENCY_MANAGER_STRUCT
+{
+    database_T* database;
+    size_t budget;
+    size_t resident_bytes;
+    unsigned long clock;
+    resident_scene_T** scenes;
+    size_t scenes_size;
+    resident_sprite_T** sprites;
+    size_t sprites_size;
+} residency_manager_T;
+
+residency_manager_T* init_residency_manager(database_T* database, size_t budget);
+
+resident_scene_T* residency_manager_get_scene(residency_manager_T* residency_manager, const char* scene_id);
+
+/**
+ * Loads scene_id and decodes the sprites of its definitions while they fit
+ * the budget, so switching to the scene does not decode them cold.
+ */
+void residency_manager_prefetch(residency_manager_T* residency_manager, const char* scene_id);
+
+sprite_T* residency_manager_get_sprite(
+    residency_manager_T* residency_manager,
+    database_actor_definition_T* database_actor_definition
+);
+
+void residency_manager_set_budget(residency_manager_T* residency_manager, size_t budget);
+
+void residency_manager_free(residency_manager_T* residency_manager);
+#endif
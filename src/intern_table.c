@@ -0,0 +1,137 @@
+#include "include/intern_table.h"
+#include "include/database_memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_TABLE_INITIAL_CAPACITY 256
+
+
+static size_t intern_table_hash(const char* string, size_t length)
+{
+    size_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) string[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+intern_table_T* init_intern_table()
+{
+    intern_table_T* intern_table = calloc(1, sizeof(struct INTERN_TABLE_STRUCT));
+    intern_table->capacity = INTERN_TABLE_INITIAL_CAPACITY;
+    intern_table->strings = calloc(intern_table->capacity, sizeof(char*));
+    pthread_mutex_init(&intern_table->lock, (void*) 0);
+
+    return intern_table;
+}
+
+static size_t intern_table_slot(char** strings, size_t capacity, const char* string, size_t length)
+{
+    size_t slot = intern_table_hash(string, length) & (capacity - 1);
+
+    while (strings[slot] != (void*) 0)
+    {
+        if (strncmp(strings[slot], string, length) == 0 && strings[slot][length] == '\0')
+            break;
+
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return slot;
+}
+
+static void intern_table_grow(intern_table_T* intern_table)
+{
+    size_t capacity = intern_table->capacity * 2;
+    char** strings = calloc(capacity, sizeof(char*));
+
+    for (size_t i = 0; i < intern_table->capacity; i++)
+    {
+        char* string = intern_table->strings[i];
+
+        if (string == (void*) 0)
+            continue;
+
+        strings[intern_table_slot(strings, capacity, string, strlen(string))] = string;
+    }
+
+    free(intern_table->strings);
+    intern_table->strings = strings;
+    intern_table->capacity = capacity;
+}
+
+char* intern_table_intern_n(intern_table_T* intern_table, const char* string, size_t length)
+{
+    if (string == (void*) 0)
+        return (void*) 0;
+
+    pthread_mutex_lock(&intern_table->lock);
+
+    size_t slot = intern_table_slot(intern_table->strings, intern_table->capacity, string, length);
+
+    char* interned = intern_table->strings[slot];
+
+    if (interned != (void*) 0)
+    {
+        pthread_mutex_unlock(&intern_table->lock);
+        return interned;
+    }
+
+    // keep the load factor below 3/4 so probe sequences stay short
+    if ((intern_table->size + 1) * 4 > intern_table->capacity * 3)
+    {
+        intern_table_grow(intern_table);
+        slot = intern_table_slot(intern_table->strings, intern_table->capacity, string, length);
+    }
+
+    char* string_new = calloc(length + 1, sizeof(char));
+    memcpy(string_new, string, length);
+    database_memory_track_alloc(DATABASE_MEMORY_STRINGS, length + 1);
+
+    intern_table->strings[slot] = string_new;
+    intern_table->size += 1;
+
+    pthread_mutex_unlock(&intern_table->lock);
+
+    return string_new;
+}
+
+char* intern_table_intern(intern_table_T* intern_table, const char* string)
+{
+    if (string == (void*) 0)
+        return (void*) 0;
+
+    return intern_table_intern_n(intern_table, string, strlen(string));
+}
+
+char* intern_table_find(intern_table_T* intern_table, const char* string)
+{
+    if (string == (void*) 0)
+        return (void*) 0;
+
+    pthread_mutex_lock(&intern_table->lock);
+    char* interned = intern_table->strings[intern_table_slot(intern_table->strings, intern_table->capacity, string, strlen(string))];
+    pthread_mutex_unlock(&intern_table->lock);
+
+    return interned;
+}
+
+void intern_table_free(intern_table_T* intern_table)
+{
+    for (size_t i = 0; i < intern_table->capacity; i++)
+    {
+        if (intern_table->strings[i] == (void*) 0)
+            continue;
+
+        database_memory_track_free(DATABASE_MEMORY_STRINGS, strlen(intern_table->strings[i]) + 1);
+        free(intern_table->strings[i]);
+    }
+
+    free(intern_table->strings);
+    pthread_mutex_destroy(&intern_table->lock);
+    free(intern_table);
+}
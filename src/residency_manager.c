@@ -0,0 +1,357 @@
+#include "include/residency_manager.h"
+#include <coelum/textures.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static size_t residency_manager_sprite_bytes(sprite_T* sprite)
+{
+    if (sprite == (void*) 0)
+        return 0;
+
+    size_t bytes = sizeof(sprite_T);
+
+    for (int i = 0; i < sprite->textures->size; i++)
+    {
+        texture_T* texture = (texture_T*) sprite->textures->items[i];
+        bytes += sizeof(texture_T) + (size_t) texture->width * texture->height * 4;
+    }
+
+    return bytes;
+}
+
+residency_manager_T* init_residency_manager(database_T* database, size_t budget)
+{
+    residency_manager_T* residency_manager = calloc(1, sizeof(struct RESIDENCY_MANAGER_STRUCT));
+    residency_manager->database = database;
+    residency_manager->budget = budget;
+
+    return residency_manager;
+}
+
+static resident_sprite_T* residency_manager_find_sprite(
+    residency_manager_T* residency_manager,
+    database_actor_definition_T* database_actor_definition
+)
+{
+    for (size_t i = 0; i < residency_manager->sprites_size; i++)
+    {
+        if (residency_manager->sprites[i]->database_actor_definition == database_actor_definition)
+            return residency_manager->sprites[i];
+    }
+
+    return (void*) 0;
+}
+
+static void residency_manager_release_sprite(residency_manager_T* residency_manager, resident_sprite_T* resident_sprite)
+{
+    if (resident_sprite->database_sprite != (void*) 0)
+        database_sprite_free(resident_sprite->database_sprite);
+
+    resident_sprite->database_sprite = (void*) 0;
+    database_actor_definition_release_sprite(resident_sprite->database_actor_definition);
+
+    residency_manager->resident_bytes -= resident_sprite->bytes;
+    resident_sprite->bytes = 0;
+}
+
+static void residency_manager_untrack_sprite(residency_manager_T* residency_manager, size_t index)
+{
+    resident_sprite_T* resident_sprite = residency_manager->sprites[index];
+
+    residency_manager->resident_bytes -= resident_sprite->bytes;
+
+    if (resident_sprite->database_sprite != (void*) 0)
+        database_sprite_free(resident_sprite->database_sprite);
+
+    database_actor_definition_free(resident_sprite->database_actor_definition);
+    free(resident_sprite);
+
+    residency_manager->sprites[index] = residency_manager->sprites[residency_manager->sprites_size - 1];
+    residency_manager->sprites_size -= 1;
+}
+
+static void residency_manager_free_scene(residency_manager_T* residency_manager, size_t index)
+{
+    resident_scene_T* resident_scene = residency_manager->scenes[index];
+
+    for (int i = 0; i < resident_scene->database_actor_instances->size; i++)
+    {
+        database_actor_instance_T* database_actor_instance =
+            (database_actor_instance_T*) resident_scene->database_actor_instances->items[i];
+
+        resident_sprite_T* resident_sprite = residency_manager_find_sprite(
+            residency_manager,
+            database_actor_instance->database_actor_definition
+        );
+
+        if (resident_sprite != (void*) 0)
+            resident_sprite->scene_references -= 1;
+
+        database_actor_instance_free(database_actor_instance);
+    }
+
+    free(resident_scene->database_actor_instances->items);
+    free(resident_scene->database_actor_instances);
+    database_scene_free(resident_scene->database_scene);
+
+    residency_manager->resident_bytes -= resident_scene->bytes;
+    free(resident_scene);
+
+    residency_manager->scenes[index] = residency_manager->scenes[residency_manager->scenes_size - 1];
+    residency_manager->scenes_size -= 1;
+
+    // sprites no scene refers to anymore are dropped, their definitions may
+    // be evicted from the definition cache at any time
+    for (size_t i = residency_manager->sprites_size; i > 0; i--)
+    {
+        if (residency_manager->sprites[i - 1]->scene_references == 0)
+        {
+            residency_manager_release_sprite(residency_manager, residency_manager->sprites[i - 1]);
+            residency_manager_untrack_sprite(residency_manager, i - 1);
+        }
+    }
+}
+
+static void residency_manager_evict_sprites(residency_manager_T* residency_manager, resident_sprite_T* keep)
+{
+    while (residency_manager->resident_bytes > residency_manager->budget)
+    {
+        resident_sprite_T* oldest_sprite = (void*) 0;
+
+        for (size_t i = 0; i < residency_manager->sprites_size; i++)
+        {
+            resident_sprite_T* resident_sprite = residency_manager->sprites[i];
+
+            if (resident_sprite == keep || resident_sprite->bytes == 0)
+                continue;
+
+            if (oldest_sprite == (void*) 0 || resident_sprite->last_used < oldest_sprite->last_used)
+                oldest_sprite = resident_sprite;
+        }
+
+        if (oldest_sprite == (void*) 0)
+            break;
+
+        residency_manager_release_sprite(residency_manager, oldest_sprite);
+    }
+}
+
+/**
+ * Evicts until the resident set fits the budget. The scene passed in is
+ * never evicted, it is the one the caller is about to use.
+ */
+static void residency_manager_enforce_budget(residency_manager_T* residency_manager, resident_scene_T* keep)
+{
+    residency_manager_evict_sprites(residency_manager, (void*) 0);
+
+    while (residency_manager->resident_bytes > residency_manager->budget)
+    {
+        size_t oldest_scene = residency_manager->scenes_size;
+
+        for (size_t i = 0; i < residency_manager->scenes_size; i++)
+        {
+            if (residency_manager->scenes[i] == keep)
+                continue;
+
+            if (oldest_scene == residency_manager->scenes_size ||
+                residency_manager->scenes[i]->last_used < residency_manager->scenes[oldest_scene]->last_used)
+                oldest_scene = i;
+        }
+
+        if (oldest_scene == residency_manager->scenes_size)
+            break;
+
+        residency_manager_free_scene(residency_manager, oldest_scene);
+    }
+}
+
+static void residency_manager_track_sprites(residency_manager_T* residency_manager, resident_scene_T* resident_scene)
+{
+    for (int i = 0; i < resident_scene->database_actor_instances->size; i++)
+    {
+        database_actor_instance_T* database_actor_instance =
+            (database_actor_instance_T*) resident_scene->database_actor_instances->items[i];
+        database_actor_definition_T* database_actor_definition = database_actor_instance->database_actor_definition;
+
+        if (database_actor_definition == (void*) 0)
+            continue;
+
+        resident_sprite_T* resident_sprite = residency_manager_find_sprite(residency_manager, database_actor_definition);
+
+        if (resident_sprite == (void*) 0)
+        {
+            resident_sprite = calloc(1, sizeof(struct RESIDENT_SPRITE_STRUCT));
+            resident_sprite->database_actor_definition = database_actor_definition;
+            database_actor_definition->references += 1;
+
+            residency_manager->sprites_size += 1;
+            residency_manager->sprites = realloc(
+                residency_manager->sprites,
+                residency_manager->sprites_size * sizeof(struct RESIDENT_SPRITE_STRUCT*)
+            );
+            residency_manager->sprites[residency_manager->sprites_size - 1] = resident_sprite;
+        }
+
+        resident_sprite->scene_references += 1;
+        resident_sprite->last_used = resident_scene->last_used;
+    }
+}
+
+resident_scene_T* residency_manager_get_scene(residency_manager_T* residency_manager, const char* scene_id)
+{
+    residency_manager->clock += 1;
+
+    for (size_t i = 0; i < residency_manager->scenes_size; i++)
+    {
+        resident_scene_T* resident_scene = residency_manager->scenes[i];
+
+        if (strcmp(resident_scene->database_scene->id, scene_id) == 0)
+        {
+            resident_scene->last_used = residency_manager->clock;
+            return resident_scene;
+        }
+    }
+
+    database_scene_T* database_scene = database_get_scene_by_id(residency_manager->database, scene_id);
+
+    if (database_scene == (void*) 0)
+        return (void*) 0;
+
+    resident_scene_T* resident_scene = calloc(1, sizeof(struct RESIDENT_SCENE_STRUCT));
+    resident_scene->database_scene = database_scene;
+    resident_scene->database_actor_instances = database_get_all_actor_instances_by_scene_id(residency_manager->database, scene_id);
+    resident_scene->last_used = residency_manager->clock;
+    resident_scene->bytes = sizeof(struct RESIDENT_SCENE_STRUCT) +
+        sizeof(struct DATABASE_SCENE_STRUCT) +
+        resident_scene->database_actor_instances->size * sizeof(struct DATABASE_ACTOR_INSTANCE_STRUCT);
+
+    residency_manager->resident_bytes += resident_scene->bytes;
+
+    residency_manager->scenes_size += 1;
+    residency_manager->scenes = realloc(
+        residency_manager->scenes,
+        residency_manager->scenes_size * sizeof(struct RESIDENT_SCENE_STRUCT*)
+    );
+    residency_manager->scenes[residency_manager->scenes_size - 1] = resident_scene;
+
+    residency_manager_track_sprites(residency_manager, resident_scene);
+    residency_manager_enforce_budget(residency_manager, resident_scene);
+
+    return resident_scene;
+}
+
+/**
+ * Loads the pixels of a tracked sprite and records them as resident.
+ * Returns 0 if the definition has no sprite.
+ */
+static unsigned int residency_manager_load_sprite(residency_manager_T* residency_manager, resident_sprite_T* resident_sprite)
+{
+    database_sprite_T* database_sprite = database_actor_definition_get_sprite(
+        residency_manager->database,
+        resident_sprite->database_actor_definition
+    );
+
+    if (database_sprite == (void*) 0)
+        return 0;
+
+    residency_manager->clock += 1;
+    resident_sprite->last_used = residency_manager->clock;
+    resident_sprite->database_sprite = database_sprite;
+    resident_sprite->bytes = residency_manager_sprite_bytes(database_sprite->sprite);
+    residency_manager->resident_bytes += resident_sprite->bytes;
+
+    return 1;
+}
+
+void residency_manager_prefetch(residency_manager_T* residency_manager, const char* scene_id)
+{
+    resident_scene_T* resident_scene = residency_manager_get_scene(residency_manager, scene_id);
+
+    if (resident_scene == (void*) 0)
+        return;
+
+    for (int i = 0; i < resident_scene->database_actor_instances->size; i++)
+    {
+        database_actor_instance_T* database_actor_instance =
+            (database_actor_instance_T*) resident_scene->database_actor_instances->items[i];
+
+        resident_sprite_T* resident_sprite = residency_manager_find_sprite(
+            residency_manager,
+            database_actor_instance->database_actor_definition
+        );
+
+        if (resident_sprite == (void*) 0 || resident_sprite->database_sprite != (void*) 0)
+            continue;
+
+        if (!residency_manager_load_sprite(residency_manager, resident_sprite))
+            continue;
+
+        // resident sprites are never evicted to make room for prefetched ones
+        if (residency_manager->resident_bytes > residency_manager->budget)
+        {
+            residency_manager_release_sprite(residency_manager, resident_sprite);
+            break;
+        }
+    }
+}
+
+sprite_T* residency_manager_get_sprite(
+    residency_manager_T* residency_manager,
+    database_actor_definition_T* database_actor_definition
+)
+{
+    resident_sprite_T* resident_sprite = residency_manager_find_sprite(residency_manager, database_actor_definition);
+
+    if (resident_sprite != (void*) 0 && resident_sprite->database_sprite != (void*) 0)
+    {
+        residency_manager->clock += 1;
+        resident_sprite->last_used = residency_manager->clock;
+
+        return resident_sprite->database_sprite->sprite;
+    }
+
+    // not managed, the definition's own reference keeps the sprite alive
+    if (resident_sprite == (void*) 0)
+    {
+        database_sprite_T* database_sprite = database_actor_definition_get_sprite(
+            residency_manager->database,
+            database_actor_definition
+        );
+
+        if (database_sprite == (void*) 0)
+            return (void*) 0;
+
+        sprite_T* sprite = database_sprite->sprite;
+        database_sprite_free(database_sprite);
+
+        return sprite;
+    }
+
+    if (!residency_manager_load_sprite(residency_manager, resident_sprite))
+        return (void*) 0;
+
+    // the sprite was just asked for, make room among the other sprites
+    residency_manager_evict_sprites(residency_manager, resident_sprite);
+
+    return resident_sprite->database_sprite->sprite;
+}
+
+void residency_manager_set_budget(residency_manager_T* residency_manager, size_t budget)
+{
+    residency_manager->budget = budget;
+    residency_manager_enforce_budget(residency_manager, (void*) 0);
+}
+
+void residency_manager_free(residency_manager_T* residency_manager)
+{
+    while (residency_manager->scenes_size > 0)
+        residency_manager_free_scene(residency_manager, residency_manager->scenes_size - 1);
+
+    while (residency_manager->sprites_size > 0)
+        residency_manager_untrack_sprite(residency_manager, residency_manager->sprites_size - 1);
+
+    free(residency_manager->scenes);
+    free(residency_manager->sprites);
+    free(residency_manager);
+}
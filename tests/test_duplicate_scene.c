@@ -0,0 +1,81 @@
+#include "test_utils.h"
+
+/**
+ * A duplicated scene gets a fresh id, is never the main scene and holds
+ * copies of the instances with fresh ids, once also with sharded scenes.
+ */
+static void test_duplicate_scene(unsigned int flags)
+{
+    system("rm -rf test_duplicate_scene.db* scenes");
+
+    database_T* database = init_database_from_file("test_duplicate_scene.db", flags);
+    char* definition_id = database_insert_actor_definition(database, "player", "", "", "", "");
+    char* scene_id = database_insert_scene(database, "level_1", 1);
+
+    for (int i = 0; i < 3; i++)
+        free(database_insert_actor_instance(database, definition_id, scene_id, i, i * 2, i * 3));
+
+    char* copy_id = database_duplicate_scene(database, scene_id, "level_1 copy");
+    assert(copy_id != (void*) 0 && strcmp(copy_id, scene_id) != 0);
+
+    // a NULL name keeps the name
+    char* other_copy_id = database_duplicate_scene(database, scene_id, (void*) 0);
+    assert(other_copy_id != (void*) 0);
+
+    assert(database_duplicate_scene(database, "no_such_scene", "copy") == (void*) 0);
+
+    assert(database_count_scenes(database) == 3);
+    assert(database_count_actors_in_scene(database, scene_id) == 3);
+    assert(database_count_actors_in_scene(database, copy_id) == 3);
+    assert(database_count_actors_in_scene(database, other_copy_id) == 3);
+
+    database_scene_T* database_scene = database_get_scene_by_id(database, copy_id);
+    assert(database_scene != (void*) 0 && strcmp(database_scene->name, "level_1 copy") == 0 && !database_scene->main);
+    database_scene_free(database_scene);
+
+    database_scene = database_get_scene_by_id(database, other_copy_id);
+    assert(database_scene != (void*) 0 && strcmp(database_scene->name, "level_1") == 0 && !database_scene->main);
+    database_scene_free(database_scene);
+
+    database_scene = database_get_scene_by_id(database, scene_id);
+    assert(database_scene != (void*) 0 && database_scene->main);
+    database_scene_free(database_scene);
+
+    dynamic_list_T* originals = database_get_all_actor_instances_by_scene_id(database, scene_id);
+    dynamic_list_T* copies = database_get_all_actor_instances_by_scene_id(database, copy_id);
+    assert(originals->size == 3 && copies->size == 3);
+
+    for (int i = 0; i < copies->size; i++)
+    {
+        database_actor_instance_T* copy = (database_actor_instance_T*) copies->items[i];
+        assert(strcmp(copy->scene_id, copy_id) == 0);
+        assert(strcmp(copy->actor_definition_id, definition_id) == 0);
+        assert(copy->z == copy->x * 3 && copy->y == copy->x * 2);
+
+        for (int j = 0; j < originals->size; j++)
+            assert(strcmp(copy->id, ((database_actor_instance_T*) originals->items[j])->id) != 0);
+    }
+
+    test_free_list(originals, (void (*)(void*)) database_actor_instance_free);
+    test_free_list(copies, (void (*)(void*)) database_actor_instance_free);
+
+    // the copy is independent of its original
+    database_delete_scene_by_id(database, scene_id);
+    assert(database_count_actors_in_scene(database, copy_id) == 3);
+
+    database_free(database);
+    free(definition_id);
+    free(scene_id);
+    free(copy_id);
+    free(other_copy_id);
+}
+
+int main(int argc, char* argv[])
+{
+    test_duplicate_scene(0);
+    test_duplicate_scene(DATABASE_SHARD_SCENES);
+
+    printf("test_duplicate_scene: OK\n");
+
+    return 0;
+}
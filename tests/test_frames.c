@@ -0,0 +1,53 @@
+#include "test_utils.h"
+#include <unistd.h>
+
+/**
+ * Frames shared between sprites are stored once and their files live as
+ * long as one sprite still references them.
+ */
+int main(int argc, char* argv[])
+{
+    database_T* database = init_database_from_file("test_frames.db", 0);
+
+    char* first_id = database_insert_sprite(database, "first", test_sprite(4, 4, 3, 0));
+    char* second_id = database_insert_sprite(database, "second", test_sprite(4, 4, 3, 1));
+
+    // frames 1 and 2 of first are frames 0 and 1 of second
+    assert(test_count(database, "SELECT count(*) FROM frames") == 4);
+    assert(test_count(database, "SELECT sum(refcount) FROM frames") == 6);
+    assert(test_count(database, "SELECT count(*) FROM frames WHERE refcount = 2") == 2);
+
+    database_sprite_T* database_sprite = database_get_sprite_by_id(database, second_id);
+    assert(database_sprite != (void*) 0 && database_sprite->sprite->textures->size == 3);
+    texture_T* texture = (texture_T*) database_sprite->sprite->textures->items[2];
+    assert(texture->width == 4 && texture->data[0] == 3);
+    database_sprite_free(database_sprite);
+
+    database_delete_sprite_by_id(database, first_id);
+
+    assert(test_count(database, "SELECT count(*) FROM frames") == 3);
+    assert(test_count(database, "SELECT count(*) FROM frames WHERE refcount != 1") == 0);
+    assert(test_count(database, "SELECT count(*) FROM sprite_frames") == 3);
+    assert(access("frames", F_OK) == 0);
+
+    sqlite3_stmt* stmt = database_exec_sql(database, "SELECT filepath FROM frames", 0);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        assert(access((const char*) sqlite3_column_text(stmt, 0), F_OK) == 0);
+
+    database_finalize(database, stmt);
+
+    database_delete_sprite_by_id(database, second_id);
+
+    assert(test_count(database, "SELECT count(*) FROM frames") == 0);
+    assert(test_count(database, "SELECT count(*) FROM sprite_frames") == 0);
+    assert(system("test -z \"$(ls frames)\"") == 0);
+
+    free(first_id);
+    free(second_id);
+    database_free(database);
+
+    printf("test_frames: OK\n");
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "test_utils.h"
+
+/**
+ * Writes made in in-memory mode are read back from the in-memory copy
+ * and are still there once the file is opened again.
+ */
+int main(int argc, char* argv[])
+{
+    system("rm -rf test_in_memory.db* frames scenes");
+
+    database_T* database = init_database_from_file("test_in_memory.db", 0);
+    char* old_scene_id = database_insert_scene(database, "old_level", 0);
+    database_free(database);
+
+    database = init_database_from_file("test_in_memory.db", DATABASE_IN_MEMORY);
+    assert(database->database_mirror != (void*) 0);
+
+    char* definition_id = database_insert_actor_definition(database, "player", "", "", "", "");
+    char* scene_id = database_insert_scene(database, "level_1", 1);
+
+    for (int i = 0; i < 3; i++)
+        free(database_insert_actor_instance(database, definition_id, scene_id, i, 0, 0));
+
+    database_update_scene_by_id(database, scene_id, "castle", 1);
+    database_delete_scene_by_id(database, old_scene_id);
+
+    // a rolled back write leaves the copy as it was
+    database_exec_write(database, (void*) 0, "BEGIN; INSERT INTO scripts(id, name, filepath) VALUES('s', 'script', 'f'); ROLLBACK;");
+
+    assert(test_count(database, "SELECT count(*) FROM scripts") == 0);
+    assert(test_count(database, "SELECT count(*) FROM scenes") == 1);
+    assert(test_count(database, "SELECT count(*) FROM scenes WHERE name = 'castle'") == 1);
+    assert(database_count_actors_in_scene(database, scene_id) == 3);
+
+    database_free(database);
+
+    database = init_database_from_file("test_in_memory.db", 0);
+
+    assert(test_count(database, "SELECT count(*) FROM scripts") == 0);
+    assert(test_count(database, "SELECT count(*) FROM scenes") == 1);
+    assert(test_count(database, "SELECT count(*) FROM scenes WHERE name = 'castle'") == 1);
+    assert(database_count_actors_in_scene(database, scene_id) == 3);
+
+    database_actor_definition_T* database_actor_definition = database_get_actor_definition_by_id(database, definition_id);
+    assert(database_actor_definition != (void*) 0 && strcmp(database_actor_definition->name, "player") == 0);
+    database_actor_definition_free(database_actor_definition);
+
+    database_free(database);
+    free(old_scene_id);
+    free(definition_id);
+    free(scene_id);
+
+    printf("test_in_memory: OK\n");
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "test_utils.h"
+#include <database_packed.h>
+
+/**
+ * Loads the scene, asserting it holds size instances and whether they
+ * came from the pack.
+ */
+static void test_load(database_T* database, const char* scene_id, int size, unsigned int packed)
+{
+    database_packed_scene_T* database_packed_scene = database_load_packed_scene(database, scene_id);
+    assert((database_packed_scene != (void*) 0) == packed);
+
+    if (database_packed_scene != (void*) 0)
+    {
+        assert((int) database_packed_scene->instances_size == size);
+        database_packed_scene_free(database_packed_scene);
+    }
+
+    dynamic_list_T* database_actor_instances = database_get_all_actor_instances_by_scene_id(database, scene_id);
+    assert(database_actor_instances->size == size);
+    test_free_list(database_actor_instances, (void (*)(void*)) database_actor_instance_free);
+}
+
+/**
+ * A scene loaded from rows is packed, inserting, updating or deleting one
+ * of its instances drops the pack and the next load sees the change.
+ */
+static void test_packed(unsigned int flags)
+{
+    system("rm -rf test_packed.db* scenes");
+
+    database_T* database = init_database_from_file("test_packed.db", flags | DATABASE_PACK_INSTANCES);
+    char* definition_id = database_insert_actor_definition(database, "player", "", "", "", "");
+    char* scene_id = database_insert_scene(database, "level_1", 1);
+    char* other_scene_id = database_insert_scene(database, "level_2", 0);
+
+    for (int i = 0; i < 3; i++)
+        free(database_insert_actor_instance(database, definition_id, scene_id, i, 0, 0));
+
+    char* instance_id = database_insert_actor_instance(database, definition_id, scene_id, 10, 0, 0);
+    free(database_insert_actor_instance(database, definition_id, other_scene_id, 0, 0, 0));
+
+    test_load(database, scene_id, 4, 0);
+
+    // the pack was queued, it is written once the writer got to it
+    database_exec_write(database, (void*) 0, "SELECT 1");
+    test_load(database, scene_id, 4, 1);
+
+    free(database_insert_actor_instance(database, definition_id, scene_id, 20, 0, 0));
+    test_load(database, scene_id, 5, 0);
+
+    assert(database_pack_scene(database, scene_id) == SQLITE_OK);
+    assert(database_pack_scene(database, other_scene_id) == SQLITE_OK);
+    test_load(database, scene_id, 5, 1);
+
+    char* schema = database_get_scene_schema(database, scene_id);
+    char sql[256];
+    sprintf(sql, "UPDATE %s.actor_instances SET x = 11 WHERE id = '%s'", schema, instance_id);
+    assert(database_exec_write(database, scene_id, sql) == SQLITE_OK);
+    free(schema);
+
+    test_load(database, scene_id, 5, 0);
+
+    dynamic_list_T* database_actor_instances = database_get_all_actor_instances_by_scene_id(database, scene_id);
+    unsigned int updated = 0;
+
+    for (int i = 0; i < database_actor_instances->size; i++)
+    {
+        database_actor_instance_T* database_actor_instance = (database_actor_instance_T*) database_actor_instances->items[i];
+
+        if (strcmp(database_actor_instance->id, instance_id) == 0)
+            updated = database_actor_instance->x == 11;
+    }
+
+    assert(updated);
+    test_free_list(database_actor_instances, (void (*)(void*)) database_actor_instance_free);
+
+    assert(database_pack_scene(database, scene_id) == SQLITE_OK);
+    database_delete_actor_instance_by_id(database, instance_id);
+    test_load(database, scene_id, 4, 0);
+
+    // only the changed scene loses its pack
+    test_load(database, other_scene_id, 1, 1);
+
+    database_free(database);
+    free(definition_id);
+    free(scene_id);
+    free(other_scene_id);
+    free(instance_id);
+}
+
+int main(int argc, char* argv[])
+{
+    test_packed(0);
+    test_packed(DATABASE_SHARD_SCENES);
+
+    printf("test_packed: OK\n");
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "test_utils.h"
+#include <database_transfer.h>
+
+/**
+ * Scenes exported from one database and imported into an empty one come
+ * back with the same ids and values, once also with sharded scenes.
+ */
+static void test_transfer(unsigned int flags)
+{
+    // each database keeps its shards next to its file
+    system("rm -rf source target scenes.jsonl && mkdir source target");
+
+    database_T* database = init_database_from_file("source/athena.db", flags);
+    char* definition_id = database_insert_actor_definition(database, "player", "", "", "", "");
+    char* scene_id = database_insert_scene(database, "level_1", 1);
+    char* other_scene_id = database_insert_scene(database, "level_2", 0);
+
+    for (int i = 0; i < 3; i++)
+        free(database_insert_actor_instance(database, definition_id, scene_id, i, i * 2, 0));
+
+    free(database_insert_actor_instance(database, definition_id, other_scene_id, 7, 7, 7));
+
+    FILE* file = fopen("scenes.jsonl", "w");
+    const char* scene_ids[] = { scene_id, other_scene_id };
+    assert(database_export_scenes(database, scene_ids, 2, file) == SQLITE_OK);
+    fclose(file);
+    database_free(database);
+
+    database = init_database_from_file("target/athena.db", flags);
+
+    file = fopen("scenes.jsonl", "r");
+    assert(database_import_scenes(database, file) == SQLITE_OK);
+    fclose(file);
+
+    // a second import skips what already exists
+    file = fopen("scenes.jsonl", "r");
+    assert(database_import_scenes(database, file) == SQLITE_OK);
+    fclose(file);
+
+    assert(database_count_scenes(database) == 2);
+    assert(database_count_actors_in_scene(database, scene_id) == 3);
+    assert(database_count_actors_in_scene(database, other_scene_id) == 1);
+
+    database_scene_T* database_scene = database_get_scene_by_id(database, scene_id);
+    assert(database_scene != (void*) 0 && strcmp(database_scene->name, "level_1") == 0 && database_scene->main);
+    database_scene_free(database_scene);
+
+    database_actor_definition_T* database_actor_definition = database_get_actor_definition_by_id(database, definition_id);
+    assert(database_actor_definition != (void*) 0 && strcmp(database_actor_definition->name, "player") == 0);
+    database_actor_definition_free(database_actor_definition);
+
+    dynamic_list_T* database_actor_instances = database_get_all_actor_instances_by_scene_id(database, other_scene_id);
+    assert(database_actor_instances->size == 1);
+    database_actor_instance_T* database_actor_instance = (database_actor_instance_T*) database_actor_instances->items[0];
+    assert(database_actor_instance->x == 7 && database_actor_instance->z == 7);
+    assert(strcmp(database_actor_instance->actor_definition_id, definition_id) == 0);
+    test_free_list(database_actor_instances, (void (*)(void*)) database_actor_instance_free);
+
+    // a broken line keeps nothing of the input
+    file = fopen("scenes.jsonl", "w");
+    fprintf(file, "{\"type\":\"scenes\",\"id\":\"new_scene\",\"name\":\"new\",\"main\":0}\n{\"type\":\n");
+    fclose(file);
+
+    file = fopen("scenes.jsonl", "r");
+    assert(database_import_scenes(database, file) != SQLITE_OK);
+    fclose(file);
+
+    assert(database_count_scenes(database) == 2);
+
+    database_free(database);
+    free(definition_id);
+    free(scene_id);
+    free(other_scene_id);
+}
+
+int main(int argc, char* argv[])
+{
+    test_transfer(0);
+    test_transfer(DATABASE_SHARD_SCENES);
+
+    printf("test_transfer: OK\n");
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef ATHENA_TEST_UTILS_H
+#define ATHENA_TEST_UTILS_H
+#include <database.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/**
+ * A sprite of frames_size width x height frames, frame i filled with
+ * seed + i so different seeds give different content.
+ */
+static inline sprite_T* test_sprite(int width, int height, int frames_size, int seed)
+{
+    sprite_T* sprite = calloc(1, sizeof(struct SPRITE_STRUCT));
+    sprite->textures = init_dynamic_list(sizeof(texture_T*));
+    sprite->width = width;
+    sprite->height = height;
+
+    for (int i = 0; i < frames_size; i++)
+    {
+        texture_T* texture = calloc(1, sizeof(struct TEXTURE_STRUCT));
+        texture->width = width;
+        texture->height = height;
+        texture->data = calloc(width * height * 4, sizeof(unsigned char));
+        memset(texture->data, seed + i, width * height * 4);
+        dynamic_list_append(sprite->textures, texture);
+    }
+
+    return sprite;
+}
+
+/**
+ * The first column of the first row sql selects, -1 without a row.
+ */
+static inline int test_count(database_T* database, const char* sql)
+{
+    sqlite3_stmt* stmt = database_exec_sql(database, (char*) sql, 0);
+    int count = -1;
+
+    if (stmt != (void*) 0 && sqlite3_step(stmt) == SQLITE_ROW)
+        count = sqlite3_column_int(stmt, 0);
+
+    database_finalize(database, stmt);
+
+    return count;
+}
+
+static inline void test_free_list(dynamic_list_T* list, void (*free_item)(void*))
+{
+    for (int i = 0; i < list->size; i++)
+        free_item(list->items[i]);
+
+    free(list->items);
+    free(list);
+}
+#endif